@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef ACCELERATION_H
+#define ACCELERATION_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// Pointer acceleration: the multiplier of the tracking scale as a function of
+// the finger speed. A curve is a struct with
+//
+//   static constexpr uint16_t at(uint16_t speed);
+//
+// taking a speed in mm/frame and returning a multiplier, both Q8. table
+// samples it at compile time into flash, so any curve costs the same at run
+// time: a lookup and a linear interpolation.
+namespace acceleration {
+// 1 + Gain * speed. Gain is Q8, per mm/frame.
+template <int Gain>
+struct linear {
+  static constexpr uint16_t at(uint16_t speed) {
+    return 256 + (uint32_t)speed * Gain / 256;
+  }
+};
+
+// Gain Low up to the speed Knee, and High past it, in the same units as
+// linear. Precise at low speed and fast at high speed.
+template <int Low, int High, int Knee>
+struct two_slopes {
+  static constexpr uint16_t at(uint16_t speed) {
+    return speed <= Knee ? linear<Low>::at(speed)
+                         : linear<Low>::at(Knee) +
+                               (uint32_t)(speed - Knee) * High / 256;
+  }
+};
+
+// The standard library isn't available on AVR, so this stands in for
+// std::make_integer_sequence.
+template <int... I>
+struct indices {};
+template <int N, int... I>
+struct make_indices : make_indices<N - 1, N - 1, I...> {};
+template <int... I>
+struct make_indices<0, I...> {
+  typedef indices<I...> type;
+};
+
+template <class Curve, int Step, class Indices>
+struct samples;
+template <class Curve, int Step, int... I>
+struct samples<Curve, Step, indices<I...> > {
+  static const uint16_t values[sizeof...(I)] PROGMEM;
+};
+template <class Curve, int Step, int... I>
+const uint16_t samples<Curve, Step, indices<I...> >::values[sizeof...(I)]
+    PROGMEM = {Curve::at((uint32_t)I * Step)...};
+
+// Curve sampled every Step mm/frame (Q8, a power of two) at Steps speeds from
+// 0. Flat past the last one.
+template <class Curve, int Steps, int Step>
+class table {
+  static_assert(Steps >= 2 && Steps <= 256, "Steps must be from 2 to 256");
+  static_assert(Step > 0 && (Step & (Step - 1)) == 0,
+                "Step must be a power of two");
+  static_assert((uint32_t)(Steps - 1) * Step <= 65535,
+                "Steps * Step must fit in a uint16_t");
+  typedef samples<Curve, Step, typename make_indices<Steps>::type> values;
+
+ public:
+  static uint16_t at(uint16_t speed) {
+    uint16_t index = speed / Step;
+    if (index >= Steps - 1) {
+      return pgm_read_word(&values::values[Steps - 1]);
+    }
+    int32_t low = pgm_read_word(&values::values[index]);
+    int32_t high = pgm_read_word(&values::values[index + 1]);
+    return low + (high - low) * (speed % Step) / Step;
+  }
+};
+}  // namespace acceleration
+
+#endif
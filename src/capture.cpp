@@ -0,0 +1,87 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <Arduino.h>
+#include "capture.h"
+#include "ps2.h"
+
+namespace capture {
+namespace {
+bool enabled_ = false;
+uint16_t sequence = 0;
+bool dropped = false;
+bool report_pending = false;
+uint8_t report_[4];
+}  // namespace
+
+void poll() {
+  while (Serial.available() > 0) {
+    int command = Serial.read();
+    if (command == 'c') {
+      enabled_ = true;
+      sequence = 0;
+      dropped = false;
+    } else if (command == 's') {
+      enabled_ = false;
+    }
+  }
+}
+
+bool enabled() { return enabled_; }
+
+void report_sent(uint8_t buttons, int8_t x, int8_t y, int8_t scroll) {
+  report_pending = true;
+  report_[0] = buttons;
+  report_[1] = x;
+  report_[2] = y;
+  report_[3] = scroll;
+}
+
+void packet_processed(const synaptics::packet& packet) {
+  if (!enabled_) {
+    report_pending = false;
+    return;
+  }
+
+  record r;
+  r.magic[0] = magic0;
+  r.magic[1] = magic1;
+  r.sequence = sequence++;
+  r.packet_time = packet.time;
+  r.processed_time = ps2::ticks();
+  memcpy(r.packet, packet.bytes, synaptics::packet_size);
+  r.flags = (report_pending ? flag_report_sent : 0) |
+            (dropped ? flag_previous_dropped : 0);
+  r.buttons = report_pending ? report_[0] : 0;
+  r.x = report_pending ? report_[1] : 0;
+  r.y = report_pending ? report_[2] : 0;
+  r.scroll = report_pending ? report_[3] : 0;
+
+  if (Serial.availableForWrite() >= (int)sizeof(r)) {
+    Serial.write(reinterpret_cast<const uint8_t*>(&r), sizeof(r));
+    dropped = false;
+  } else {
+    dropped = dropped || report_pending;
+  }
+  report_pending = false;
+}
+}  // namespace capture
@@ -0,0 +1,72 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "synaptics.h"
+
+// Streams every packet, with its time stamps and the HID report sent while
+// processing it, as fixed-size binary records over the serial port. Send 'c'
+// over the serial port to start capturing and 's' to stop. Text logging is
+// suppressed while capturing, so it doesn't corrupt the stream.
+namespace capture {
+
+const uint8_t magic0 = 'T';
+const uint8_t magic1 = 'P';
+
+// Set in record::flags if a report was sent while processing the packet.
+const uint8_t flag_report_sent = 0x01;
+// Set if a report was sent but didn't make it into a record, because the
+// previous records couldn't be written out fast enough.
+const uint8_t flag_previous_dropped = 0x02;
+
+// All fields are little-endian.
+struct record {
+  uint8_t magic[2];
+  // Incremented for each packet, including the ones whose record couldn't be
+  // sent. A gap means records were lost.
+  uint16_t sequence;
+  // ps2::ticks() when the last byte of the packet arrived and when processing
+  // it finished.
+  uint16_t packet_time;
+  uint16_t processed_time;
+  uint8_t packet[synaptics::packet_size];
+  uint8_t flags;
+  uint8_t buttons;
+  int8_t x;
+  int8_t y;
+  int8_t scroll;
+} __attribute__((packed));
+
+// Handles start and stop commands. Call from loop().
+void poll();
+bool enabled();
+// Call when a report is sent to the host.
+void report_sent(uint8_t buttons, int8_t x, int8_t y, int8_t scroll);
+// Call when a packet has been processed. Writes its record if capturing and
+// if it fits in the serial buffer without blocking. Otherwise the record is
+// dropped, so capturing never delays the reports.
+void packet_processed(const synaptics::packet& packet);
+}  // namespace capture
+
+#endif
@@ -0,0 +1,101 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <Arduino.h>
+#include "errors.h"
+#include "queue.h"
+
+namespace errors {
+namespace {
+struct entry {
+  code c;
+  uint8_t data;
+};
+
+// Entries that don't fit are dropped, but still counted.
+SpscQueue<entry, 16> pending;
+uint16_t counts[code_count];
+
+// Longest line printed by print_pending().
+const int max_line_length = 32;
+}  // namespace
+
+void record(code c, uint8_t data) {
+  uint8_t sreg = SREG;
+  cli();
+  counts[c]++;
+  entry e = {c, data};
+  pending.push_back(e);
+  SREG = sreg;
+}
+
+uint16_t count(code c) {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t value = counts[c];
+  SREG = sreg;
+  return value;
+}
+
+bool print_pending() {
+  if (pending.empty() || Serial.availableForWrite() < max_line_length) {
+    return false;
+  }
+
+  entry e = pending.front();
+  pending.pop_front();
+  switch (e.c) {
+    case ps2_start_bit:
+      Serial.print(F("Start bit error. "));
+      break;
+    case ps2_parity:
+      Serial.print(F("Parity bit error. "));
+      break;
+    case ps2_stop_bit:
+      Serial.print(F("Stop bit error. "));
+      break;
+    case ps2_timeout:
+      Serial.print(F("Bit timeout. "));
+      break;
+    case ps2_line_control:
+      Serial.print(F("Line control error. "));
+      break;
+    case ps2_no_ack:
+      Serial.print(F("No ACK. "));
+      break;
+    case unexpected_byte0:
+      Serial.print(F("Unexpected byte0 data "));
+      break;
+    case unexpected_byte3:
+      Serial.print(F("Unexpected byte3 data "));
+      break;
+    case packet_overflow:
+      Serial.print(F("Packet dropped. "));
+      break;
+    default:
+      Serial.print(F("Unknown error. "));
+      break;
+  }
+  Serial.println(e.data, HEX);
+  return true;
+}
+}  // namespace errors
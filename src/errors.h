@@ -0,0 +1,55 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef ERRORS_H
+#define ERRORS_H
+
+// Errors detected in interrupt context can't be printed right away, since
+// Serial may block and ruin the timing of the bits that follow. Instead they
+// are recorded as compact codes and printed later from loop().
+namespace errors {
+
+enum code : uint8_t {
+  ps2_start_bit,
+  ps2_parity,
+  ps2_stop_bit,
+  ps2_timeout,
+  ps2_line_control,
+  ps2_no_ack,
+  unexpected_byte0,
+  unexpected_byte3,
+  packet_overflow,
+  code_count,
+};
+
+// Records an error and the byte it relates to. Safe to call from both
+// interrupt and main context.
+void record(code c, uint8_t data = 0);
+// Number of times an error has been recorded since startup.
+uint16_t count(code c);
+// Prints the oldest recorded error, if there is one and Serial has room for
+// it without blocking. Returns false if there was nothing to print. Only call
+// from loop().
+bool print_pending();
+}  // namespace errors
+
+#endif
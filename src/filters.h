@@ -0,0 +1,259 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <stdint.h>
+
+// Filters that smooth finger positions. They share an interface, so that
+// finger_state can take any of them as a template argument:
+//
+//   averages<T> update(T data);  // Adds a sample.
+//   T filter(T data);            // Adds a sample, returns the new output.
+//   T average() const;           // The last output, 0 if there's none.
+//   void reset();                // Forgets all samples.
+//
+// Everything is inline and resolved at compile time, so swapping one for
+// another costs nothing beyond the filter itself.
+
+// The outputs before and after a sample is added.
+template <class T>
+struct averages {
+  T previous;
+  T current;
+};
+
+// Like SimpleAverage, but the window is a power of two so that, once the
+// window is full, the division by the constant N compiles to shifts instead
+// of a call to the division routine. The average is kept, so average() costs
+// nothing. The sum must fit in an int.
+template <class T, int N>
+class PowerOfTwoAverage {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+ private:
+  T m_buffer[N];
+  int m_count;
+  int m_sum;
+  int m_index;
+  T m_average;
+
+ public:
+  inline PowerOfTwoAverage() { reset(); }
+  averages<T> update(T data) {
+    averages<T> result;
+    result.previous = m_average;
+    m_sum += data;
+    if (m_count == N) {
+      m_sum -= m_buffer[m_index];
+    } else {
+      ++m_count;
+    }
+    m_buffer[m_index] = data;
+    m_index = (m_index + 1) & (N - 1);
+    // Only the first N - 1 samples after a reset need a real division.
+    m_average = m_count == N ? m_sum / N : m_sum / m_count;
+    result.current = m_average;
+    return result;
+  }
+  T filter(T data) { return update(data).current; }
+  inline void reset() {
+    m_count = 0;
+    m_sum = 0;
+    m_index = 0;
+    m_average = 0;
+  }
+  inline int count() const { return m_count; }
+  inline int sum() const { return m_sum; }
+  T average() const { return m_average; }
+};
+
+// Exponential moving average, giving a weight of 1/2^K to the new sample.
+// Cheaper than a moving average and with no window to keep, but its lag
+// grows with K. The state keeps K fractional bits, so that slow movements
+// aren't lost to rounding. The first sample after a reset is taken as is.
+template <class T, int K>
+class ExponentialAverage {
+  static_assert(K > 0 && K < 8, "K must be from 1 to 7");
+
+ private:
+  long m_state;
+  bool m_empty;
+
+ public:
+  inline ExponentialAverage() { reset(); }
+  averages<T> update(T data) {
+    averages<T> result;
+    result.previous = average();
+    if (m_empty) {
+      m_state = (long)data << K;
+      m_empty = false;
+    } else {
+      m_state += data - (m_state >> K);
+    }
+    result.current = average();
+    return result;
+  }
+  T filter(T data) { return update(data).current; }
+  inline void reset() {
+    m_state = 0;
+    m_empty = true;
+  }
+  T average() const { return (m_state + (1 << (K - 1))) >> K; }
+};
+
+// Replaces each sample with the median of the last 3 before passing it on to
+// Filter. Removes single-sample spikes at the cost of one more sample of lag.
+template <class T, class Filter>
+class MedianOf3 {
+ private:
+  T m_samples[3];
+  uint8_t m_count;
+  Filter m_filter;
+
+  static T median(T a, T b, T c) {
+    if (a > b) {
+      T t = a;
+      a = b;
+      b = t;
+    }
+    // Now a <= b.
+    return c <= a ? a : (c >= b ? b : c);
+  }
+
+ public:
+  inline MedianOf3() { reset(); }
+  averages<T> update(T data) {
+    m_samples[0] = m_samples[1];
+    m_samples[1] = m_samples[2];
+    m_samples[2] = data;
+    if (m_count < 3) {
+      m_count++;
+      return m_filter.update(data);
+    }
+    return m_filter.update(median(m_samples[0], m_samples[1], m_samples[2]));
+  }
+  T filter(T data) { return update(data).current; }
+  inline void reset() {
+    m_samples[0] = m_samples[1] = m_samples[2] = 0;
+    m_count = 0;
+    m_filter.reset();
+  }
+  T average() const { return m_filter.average(); }
+};
+
+// One Euro filter (Casiez et al., CHI 2012): a low-pass filter whose cutoff
+// rises with speed, so that a still finger is smoothed a lot and a moving one
+// hardly lags. It is parameterized by the smoothing factor alpha in Q8, which
+// is about proportional to the cutoff while it's small, instead of by the
+// cutoff, to avoid a division per sample. Alpha is MinAlpha for a still
+// finger, plus Beta per raw unit/frame of speed, up to 1. The speed is the
+// distance from the output to the new sample, smoothed with a factor of 1/4.
+// Output and speed keep 8 fractional bits.
+template <class T, int MinAlpha, int Beta>
+class OneEuroFilter {
+  static_assert(MinAlpha > 0 && MinAlpha <= 256, "MinAlpha is Q8, up to 1");
+
+ private:
+  long m_value;
+  long m_speed;
+  bool m_empty;
+
+ public:
+  inline OneEuroFilter() { reset(); }
+  averages<T> update(T data) {
+    averages<T> result;
+    result.previous = average();
+    long error = ((long)data << 8) - m_value;
+    if (m_empty) {
+      m_value = (long)data << 8;
+      m_empty = false;
+    } else {
+      m_speed += ((error < 0 ? -error : error) - m_speed) >> 2;
+      long alpha = MinAlpha + (Beta * m_speed >> 8);
+      if (alpha > 256) {
+        alpha = 256;
+      }
+      m_value += error * alpha >> 8;
+    }
+    result.current = average();
+    return result;
+  }
+  T filter(T data) { return update(data).current; }
+  inline void reset() {
+    m_value = 0;
+    m_speed = 0;
+    m_empty = true;
+  }
+  T average() const { return (m_value + 128) >> 8; }
+};
+
+// Alpha-beta tracker: a constant velocity Kalman filter with fixed gains.
+// It estimates position and velocity, and outputs the position it predicts
+// Predict frames ahead, which makes up for the lag of the smoothing. Alpha
+// and Beta are the gains of position and velocity, in Q8. Beta =
+// Alpha^2 / (2 - Alpha) is critically damped, larger values overshoot when
+// the finger stops. State keeps 8 fractional bits.
+template <class T, int Alpha, int Beta, int Predict>
+class AlphaBetaTracker {
+  static_assert(Alpha > 0 && Alpha <= 256, "Alpha is Q8, up to 1");
+  static_assert(Beta >= 0 && Beta <= 256, "Beta is Q8, up to 1");
+  static_assert(Predict >= 0, "Predict is in frames");
+
+ private:
+  long m_position;
+  long m_velocity;
+  bool m_empty;
+
+ public:
+  inline AlphaBetaTracker() { reset(); }
+  averages<T> update(T data) {
+    averages<T> result;
+    result.previous = average();
+    if (m_empty) {
+      m_position = (long)data << 8;
+      m_empty = false;
+    } else {
+      m_position += m_velocity;
+      long residual = ((long)data << 8) - m_position;
+      m_position += residual * Alpha >> 8;
+      m_velocity += residual * Beta >> 8;
+    }
+    result.current = average();
+    return result;
+  }
+  T filter(T data) { return update(data).current; }
+  inline void reset() {
+    m_position = 0;
+    m_velocity = 0;
+    m_empty = true;
+  }
+  T average() const {
+    if (m_empty) {
+      return 0;
+    }
+    return (m_position + m_velocity * Predict + 128) >> 8;
+  }
+};
+
+#endif
@@ -0,0 +1,110 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <Arduino.h>
+#include "profile.h"
+
+namespace profile {
+namespace {
+struct stats {
+  uint16_t count;
+  uint16_t min;
+  uint16_t max;
+  uint32_t total;
+};
+
+stats stats_[path_count];
+
+// Measurements per printed line. At 80 packets per second a busy path prints
+// every few seconds.
+const uint16_t samples_per_line = 256;
+// Longest line printed by print_pending().
+const int max_line_length = 48;
+}  // namespace
+
+void begin() {
+  // Normal mode, no prescaler.
+  TCCR3A = 0;
+  TCCR3B = _BV(CS30);
+}
+
+void start() {
+  TCNT3 = 0;
+  TIFR3 = _BV(TOV3);
+}
+
+void stop(path p) {
+  uint16_t cycles = TCNT3;
+  if (TIFR3 & _BV(TOV3)) {
+    cycles = 0xFFFF;
+  }
+
+  stats& s = stats_[p];
+  if (s.count == 0 || cycles < s.min) {
+    s.min = cycles;
+  }
+  if (cycles > s.max) {
+    s.max = cycles;
+  }
+  s.total += cycles;
+  s.count++;
+}
+
+bool print_pending() {
+  if (Serial.availableForWrite() < max_line_length) {
+    return false;
+  }
+
+  for (uint8_t p = 0; p < path_count; p++) {
+    stats& s = stats_[p];
+    if (s.count < samples_per_line) {
+      continue;
+    }
+    switch (p) {
+      case idle:
+        Serial.print(F("Idle"));
+        break;
+      case tracking:
+        Serial.print(F("Tracking"));
+        break;
+      case scrolling:
+        Serial.print(F("Scrolling"));
+        break;
+      case extended:
+        Serial.print(F("Extended"));
+        break;
+      case guest:
+        Serial.print(F("Guest"));
+        break;
+    }
+    Serial.print(F(" cycles min/mean/max: "));
+    Serial.print(s.min);
+    Serial.print('/');
+    Serial.print(s.total / s.count);
+    Serial.print('/');
+    Serial.println(s.max);
+    s = stats();
+    return true;
+  }
+  return false;
+}
+}  // namespace profile
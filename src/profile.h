@@ -0,0 +1,54 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Cycle counts of the paths through process_pending_packet(), measured on the
+// device with Timer3 running at the CPU clock. Interrupts serviced during a
+// measurement are counted too, which mostly shows in the max.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+namespace profile {
+enum path : uint8_t {
+  idle,       // No finger on the touchpad.
+  tracking,   // Moving the cursor, with one or more fingers.
+  scrolling,  // Two fingers, no button.
+  extended,   // Secondary finger packet.
+  guest,      // Pass-through packet.
+  path_count
+};
+
+// Starts Timer3, which is not used otherwise.
+void begin();
+// Marks the start of a measurement.
+void start();
+// Ends the measurement and attributes it to `p`. Measurements longer than
+// 65535 cycles (4ms) saturate.
+void stop(path p);
+// Prints min/mean/max of a path with enough measurements, then starts over
+// for that path. Returns whether a line was printed.
+bool print_pending();
+}  // namespace profile
+
+#endif  // PROFILE_H
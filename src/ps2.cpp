@@ -22,76 +22,282 @@
 
 #include <Arduino.h>
 #include "ps2.h"
+#include "errors.h"
+#include "queue.h"
 
 namespace ps2 {
 // Sample code for interacting with a PS2 mouse from a mega32u4.
-// Writing is synchronous. Async write is hard for the client to handle.
+// Both directions are driven by the clock interrupt. Writing can be done
+// asynchronously with begin_transfer() and poll_transfer(), or synchronously
+// with write_byte(). Commands are queued with submit() and sent by poll() from
+// the main loop. ps2_command() is a synchronous wrapper for them. Interrupts
+// stay enabled in all cases.
 namespace {  // anonymous namespace to hide code from the client.
 // On atmel mega32u4, clock_pin needs to be one of these: 0, 1, 2, 3, 7,
 // otherwise, we need to use pin change interrupt.
-int clock_pin_;
-int data_pin_;
-void (*byte_received_)(uint8_t);
 
-void pull_low(uint8_t pin) {
-  pinMode(pin, OUTPUT);
-  digitalWrite(pin, LOW);
+// The port registers and bit mask of a pin. They are resolved once in begin()
+// so that the interrupt handler can sample a pin with a single register read
+// instead of going through the lookup tables of digitalRead() and pinMode().
+struct pin {
+  volatile uint8_t* input;
+  volatile uint8_t* mode;
+  volatile uint8_t* output;
+  uint8_t mask;
+};
+
+pin clock_;
+pin data_;
+void (*byte_received_)(uint8_t, uint16_t, bool);
+
+void resolve_pin(uint8_t number, pin& p) {
+  uint8_t port = digitalPinToPort(number);
+  p.input = portInputRegister(port);
+  p.mode = portModeRegister(port);
+  p.output = portOutputRegister(port);
+  p.mask = digitalPinToBitMask(number);
 }
 
-void pull_high(uint8_t pin) { pinMode(pin, INPUT_PULLUP); }
+// The clock and data pins may share a port, so the read-modify-write of the
+// mode and output registers must not be interrupted.
+void pull_low(const pin& p) {
+  uint8_t sreg = SREG;
+  cli();
+  *p.output &= ~p.mask;
+  *p.mode |= p.mask;
+  SREG = sreg;
+}
 
-uint8_t read_bit() {
-  pinMode(data_pin_, INPUT);
-  return digitalRead(data_pin_);
+// Release the line and let the pull-up resistor bring it high.
+void pull_high(const pin& p) {
+  uint8_t sreg = SREG;
+  cli();
+  *p.mode &= ~p.mask;
+  *p.output |= p.mask;
+  SREG = sreg;
 }
 
-void write_bit(uint8_t data) {
-  pinMode(data_pin_, OUTPUT);
-  digitalWrite(data_pin_, data);
+inline uint8_t read_pin(const pin& p) {
+  return (*p.input & p.mask) ? HIGH : LOW;
 }
 
-void wait_clock(uint8_t value) {
-  if (value == LOW) {
-    pinMode(clock_pin_, INPUT_PULLUP);
-  } else {
-    pinMode(clock_pin_, INPUT);
-  }
+inline uint8_t read_bit() { return read_pin(data_); }
 
-  unsigned long millis_start = millis();
-  while (digitalRead(clock_pin_) != value) {
-    if (millis() - millis_start > 25) {
-      Serial.println("wait_clock timed out.");
-      return;
-    }
+// PS/2 lines are open collector. A 1 is written by releasing the line.
+void write_bit(uint8_t data) {
+  if (data) {
+    pull_high(data_);
+  } else {
+    pull_low(data_);
   }
 }
 
-volatile int receive_index = 0;
+volatile uint8_t receive_index = 0;
 volatile uint8_t receive_buffer = 0;
 volatile uint8_t parity = 0;
-
-void disable_interrupt() {
+// Set if the start, parity or stop bit of the byte being received is wrong.
+volatile bool receive_error = false;
+
+// Host to device transmission, driven by the same clock interrupt as
+// receiving. transmit_index is the bit to be sent on the next falling edge:
+// 1-8 payload, 9 parity, 10 stop, 11 line control (the ACK bit from the
+// device). 0 means no transmission is going on.
+const uint8_t transmit_request = 0xFF;
+volatile uint8_t transmit_index = 0;
+volatile uint8_t transmit_buffer = 0;
+volatile uint8_t transmit_parity = 0;
+
+// While a transfer is in progress, bytes from the device are responses (ACK
+// and command results) and are collected here instead of being passed to the
+// client.
+const uint8_t max_responses = 4;
+uint8_t response_buffer[max_responses];
+volatile uint8_t response_count = 0;
+volatile uint8_t response_expected = 0;
+volatile transfer_status status_ = transfer_idle;
+unsigned long transfer_started_ = 0;
+unsigned long transfer_timeout_ = 0;
+
+const uint8_t ack = 0xFA;
+const uint8_t resend = 0xFE;
+
+// How many times a request is retried after a RESEND, an ERROR or a timeout,
+// before it fails.
+const uint8_t max_retries = 3;
+
+// When the last byte from the device was received. Commands are only started
+// when the device has been quiet for a while, i.e. between two packets.
+volatile unsigned long last_received_ = 0;
+const unsigned long quiet_millis = 2;
+
+// Commands waiting to be sent, and the one being sent. Both are only touched
+// from the main context.
+SpscQueue<request*, 8> requests;
+request* current_ = nullptr;
+
+// A 32-bit value written by the ISR can't be read in one instruction.
+unsigned long last_received() {
+  uint8_t sreg = SREG;
   cli();
-  // We need to abandon the ongoing read from the device.
-  // Otherwise it'll go haywire next time we enable interrupt.
+  unsigned long value = last_received_;
+  SREG = sreg;
+  return value;
+}
+
+void complete(request_status status) {
+  request* r = current_;
+  current_ = nullptr;
+  r->status = status;
+  if (r->callback != nullptr) {
+    r->callback(r);
+  }
+}
+
+// Sends the next byte of the current request. Byte 0 is the command itself,
+// followed by the arguments. The responses follow the ACK of the last byte.
+bool send_next_byte() {
+  uint8_t send = (current_->command >> 12) & 0x0F;
+  uint8_t receive = (current_->command >> 8) & 0x0F;
+  uint8_t index = current_->sent;
+  uint8_t data =
+      index == 0 ? current_->command & 0xFF : current_->args[index - 1];
+  if (!begin_transfer(data, index == send ? receive : 0)) {
+    return false;
+  }
+  current_->sent++;
+  return true;
+}
+
+void abandon_receive() {
   receive_index = 0;
   receive_buffer = 0;
   parity = 0;
+  receive_error = false;
+}
+
+// Timer1 runs freely at 250kHz, i.e. 4us per tick. Compare match A is used as
+// a watchdog for partial frames: it is pushed back on every clock edge of a
+// byte and fires if the next edge doesn't come in time. The timeout needs to be
+// shorter than the idle time between two bytes, otherwise a byte with a missed
+// edge runs into the next one. The clock runs at 10-16.7kHz, so edges are
+// 60-100us apart, and at the fastest clock the next start bit can follow the
+// stop bit by as little as 120us. The timeout is therefore 1.5 times the last
+// edge interval of the byte, within the bounds of the spec.
+const uint16_t min_bit_timeout_ticks = 90 / 4;
+const uint16_t max_bit_timeout_ticks = 150 / 4;
+// Only used by the clock interrupt.
+uint16_t last_edge_ = 0;
+
+void start_timer() {
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11) | _BV(CS10);
+  TIMSK1 = 0;
+}
+
+inline void arm_watchdog(uint16_t now, uint16_t timeout) {
+  OCR1A = now + timeout;
+  TIFR1 = _BV(OCF1A);
+  TIMSK1 |= _BV(OCIE1A);
+}
+
+inline void disarm_watchdog() { TIMSK1 &= ~_BV(OCIE1A); }
+
+// An edge was missed. Reset the state machine so the next byte starts clean,
+// instead of being shifted by one bit.
+void bit_timeout() {
+  disarm_watchdog();
+  errors::record(errors::ps2_timeout, receive_index);
+  if (transmit_index != 0 && transmit_index != transmit_request) {
+    transmit_index = 0;
+    pull_high(data_);
+    status_ = transfer_error;
+  } else if (receive_index != 0 && status_ != transfer_busy) {
+    // Let the client know a byte has been lost.
+    byte_received_(receive_buffer, TCNT1, true);
+  }
+  abandon_receive();
+}
+
+void response_received(uint8_t data, bool error) {
+  if (error) {
+    // The framing error is already recorded. Neither an ACK nor a result can
+    // be trusted, so the command is started over.
+    status_ = transfer_error;
+    return;
+  }
+  response_buffer[response_count++] = data;
+  if (response_count == 1 && data != ack) {
+    // No more bytes will follow a RESEND or ERROR.
+    errors::record(errors::ps2_no_ack, data);
+    status_ = data == resend ? transfer_resend : transfer_error;
+  } else if (response_count == response_expected) {
+    status_ = transfer_done;
+  }
 }
 
-void enable_interrupt() { sei(); }
+void bit_transmitted() {
+  if (transmit_index <= 8) {
+    // Payload bit, LSB first.
+    uint8_t bit = transmit_buffer & 0x01;
+    transmit_buffer >>= 1;
+    transmit_parity ^= bit;
+    write_bit(bit);
+  } else if (transmit_index == 9) {
+    write_bit(transmit_parity);
+  } else if (transmit_index == 10) {
+    // Stop bit. Release the data line.
+    write_bit(HIGH);
+  } else {
+    // Line control bit. The device acknowledges by pulling data low.
+    disarm_watchdog();
+    transmit_index = 0;
+    if (read_bit() != LOW) {
+      errors::record(errors::ps2_line_control);
+      status_ = transfer_error;
+    }
+    return;
+  }
+
+  transmit_index++;
+}
 
 void bit_received() {
-  int clock = digitalRead(clock_pin_);
-  if (clock != LOW) {
+  if (read_pin(clock_) != LOW) {
+    return;
+  }
+
+  if (transmit_index == transmit_request) {
+    // We are inhibiting the bus ourselves.
+    return;
+  }
+
+  uint16_t now = TCNT1;
+  if (transmit_index != 0) {
+    arm_watchdog(now, max_bit_timeout_ticks);
+    bit_transmitted();
     return;
   }
 
-  int bit = read_bit();
+  // The bit period is only known from the second edge of a byte on.
+  uint16_t timeout = max_bit_timeout_ticks;
+  if (receive_index != 0) {
+    uint16_t interval = now - last_edge_;
+    timeout = interval + interval / 2;
+    if (timeout < min_bit_timeout_ticks) {
+      timeout = min_bit_timeout_ticks;
+    } else if (timeout > max_bit_timeout_ticks) {
+      timeout = max_bit_timeout_ticks;
+    }
+  }
+  last_edge_ = now;
+  arm_watchdog(now, timeout);
+
+  uint8_t bit = read_bit();
   if (receive_index == 0) {
     // Start bit
     if (bit != LOW) {
-      Serial.println("Start bit error.");
+      errors::record(errors::ps2_start_bit);
+      receive_error = true;
     }
   } else if (receive_index >= 1 && receive_index <= 8) {
     // Payload bit
@@ -101,157 +307,206 @@ void bit_received() {
     // Parity bit
     parity ^= bit;
     if (parity != 1) {
-      Serial.println("Parity bit error.");
+      errors::record(errors::ps2_parity, receive_buffer);
+      receive_error = true;
     }
 
   } else if (receive_index == 10) {
     // Stop bit
     if (bit != HIGH) {
-      Serial.println("Stop bit error.");
+      errors::record(errors::ps2_stop_bit, receive_buffer);
+      receive_error = true;
+    }
+    disarm_watchdog();
+    last_received_ = millis();
+    if (status_ == transfer_busy) {
+      response_received(receive_buffer, receive_error);
+    } else {
+      byte_received_(receive_buffer, now, receive_error);
     }
-    byte_received_(receive_buffer);
-    receive_buffer = 0;
-    receive_index = 0;
-    parity = 0;
+    abandon_receive();
     return;
   }
 
   receive_index++;
 }
+}  // namespace
 
-// Reads a byte synchronously. This should only be called from write_byte() to
-// read the response and shouldn't be called by the client.
-uint8_t read_byte() {
-  // Start bit
-  wait_clock(LOW);
-  uint8_t start_bit = read_bit();
-  if (start_bit != LOW) {
-    Serial.println("Start bit error.");
+bool begin_transfer(uint8_t data, uint8_t receive) {
+  if (status_ == transfer_busy || receive >= max_responses) {
+    return false;
   }
-  wait_clock(HIGH);
-
-  uint8_t data = 00;
-  uint8_t parity = 0;
-  for (int i = 0; i < 8; i++) {
-    wait_clock(LOW);
-    uint8_t bit = read_bit();
-    wait_clock(HIGH);
 
-    data |= bit << i;
-    parity ^= bit;
+  // Inhibit the device. It abandons any byte it is sending, and so do we.
+  transmit_index = transmit_request;
+  pull_low(clock_);
+  uint8_t sreg = SREG;
+  cli();
+  disarm_watchdog();
+  SREG = sreg;
+  if (receive_index != 0) {
+    // Let the client know a byte has been lost, as bit_timeout() does. The
+    // clock interrupt ignores the bus from now on.
+    byte_received_(receive_buffer, ticks(), true);
   }
+  abandon_receive();
+
+  transmit_buffer = data;
+  transmit_parity = 1;
+  response_count = 0;
+  response_expected = 1 + receive;
+  // The device has 25ms to clock in the byte and ACK it. BAT after a reset
+  // takes up to 750ms.
+  transfer_timeout_ = receive == 0 ? 25 : 1000;
+  transfer_started_ = millis();
+  status_ = transfer_busy;
+
+  // Bring CLK low for 100 us. Interrupts stay enabled.
+  delayMicroseconds(100);
+  // Bring DATA low.
+  pull_low(data_);
+  transmit_index = 1;
+  // Release CLK. Now we are in the request-to-send state and the device
+  // clocks the bits in.
+  pull_high(clock_);
+  return true;
+}
 
-  wait_clock(LOW);
-  parity ^= read_bit();
-  wait_clock(HIGH);
-  if (parity != 1) {
-    Serial.println("Parity error.");
+transfer_status poll_transfer(uint8_t* responses) {
+  if (status_ == transfer_busy &&
+      millis() - transfer_started_ > transfer_timeout_) {
+    // Give up on the device and get the bus back to idle.
+    errors::record(errors::ps2_no_ack, response_count);
+    uint8_t sreg = SREG;
+    cli();
+    transmit_index = 0;
+    abandon_receive();
+    pull_high(data_);
+    status_ = transfer_error;
+    SREG = sreg;
   }
 
-  wait_clock(LOW);
-  uint8_t stop = read_bit();
-  if (stop != 1) {
-    Serial.println("Stop bit error.");
+  transfer_status status = status_;
+  if (status == transfer_done && responses != nullptr) {
+    // Skip the ACK.
+    for (uint8_t i = 1; i < response_count; i++) {
+      responses[i - 1] = response_buffer[i];
+    }
   }
-  pull_low(clock_pin_);
-  delayMicroseconds(50);
-  pull_high(clock_pin_);
-
-  return data;
+  if (status != transfer_busy) {
+    status_ = transfer_idle;
+  }
+  return status;
 }
-}  // namespace
 
-bool write_byte(uint8_t data) {
-  // Bring CLK low for 100 us.
-  pull_low(clock_pin_);
-  delayMicroseconds(100);
-  // Bring DATA low.
-  pull_low(data_pin_);
-  // Release CLK
-  pull_high(clock_pin_);
-  // Now we are in the request-to-send state.
-
-  uint8_t const stop = 1;
-  uint8_t parity = 1;
-
-  // bits 0 - 7: payload
-  for (int i = 0; i < 8; i++) {
-    // Get the LSB
-    uint8_t bit = data & 0x01;
-    // Update parity
-    parity ^= bit;
-    // Shift data for next iteration
-    data >>= 1;
+bool write_byte(uint8_t data, uint8_t* result, uint8_t receive) {
+  for (uint8_t attempt = 0; attempt <= max_retries; attempt++) {
+    if (!begin_transfer(data, receive)) {
+      return false;
+    }
 
-    // Device samples when CLK is low.
-    wait_clock(LOW);
-    write_bit(bit);
-    wait_clock(HIGH);
-  }
+    transfer_status status;
+    while ((status = poll_transfer(result)) == transfer_busy) {
+    }
 
-  // bit 8: parity
-  wait_clock(LOW);
-  write_bit(parity);
-  wait_clock(HIGH);
-
-  // bit 9: stop
-  wait_clock(LOW);
-  write_bit(stop);
-  wait_clock(HIGH);
-
-  // bit 10: line control
-  wait_clock(LOW);
-  uint8_t line_control = read_bit();
-  wait_clock(HIGH);
-  if (line_control != LOW) {
-    Serial.println("Line control error.");
+    if (status == transfer_done) {
+      return true;
+    }
   }
 
-  uint8_t ack = read_byte();
-  if (ack != 0xFA) {
-    Serial.println("Error: did not receive ACK");
-    return false;
-  }
+  // Each failed attempt has been recorded in the error log, which loop()
+  // prints unless a capture is running.
+  return false;
 }
 
 void begin(uint8_t clock_pin, uint8_t data_pin,
-           void (*byte_received)(uint8_t)) {
-  clock_pin_ = clock_pin;
-  data_pin_ = data_pin;
+           void (*byte_received)(uint8_t, uint16_t, bool)) {
+  resolve_pin(clock_pin, clock_);
+  resolve_pin(data_pin, data_);
   byte_received_ = byte_received;
 
-  pull_high(clock_pin);
-  pull_high(data_pin);
+  pull_high(clock_);
+  pull_high(data_);
 
-  attachInterrupt(digitalPinToInterrupt(clock_pin_), bit_received, FALLING);
+  start_timer();
+  attachInterrupt(digitalPinToInterrupt(clock_pin), bit_received, FALLING);
 }
 
-bool ps2_command(uint16_t command, uint8_t* args, uint8_t* result) {
-  disable_interrupt();
+uint16_t ticks() {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t value = TCNT1;
+  SREG = sreg;
+  return value;
+}
+
+bool submit(request* r) {
+  r->status = request_pending;
+  r->sent = 0;
+  r->retries = 0;
+  return requests.push_back(r);
+}
 
-  unsigned int send = (command >> 12) & 0x0F;
-  unsigned int receive = (command >> 8) & 0x0F;
-  write_byte(command & 0xFF);
+void poll() {
+  if (current_ == nullptr) {
+    if (requests.empty() || millis() - last_received() < quiet_millis) {
+      return;
+    }
+    current_ = requests.front();
+    requests.pop_front();
+    if (!send_next_byte()) {
+      complete(request_failed);
+    }
+    return;
+  }
 
-  for (int i = 0; i < send; i++) {
-    write_byte(args[i]);
+  transfer_status status = poll_transfer(current_->result);
+  if (status == transfer_busy) {
+    return;
   }
 
-  for (int i = 0; i < receive; i++) {
-    uint8_t response = read_byte();
-    if (result != nullptr) {
-      result[i] = response;
+  uint8_t send = (current_->command >> 12) & 0x0F;
+  if (status != transfer_done) {
+    if (current_->retries++ == max_retries) {
+      complete(request_failed);
+      return;
+    }
+    // RESEND asks for the last byte again. ERROR means the device failed to
+    // receive it twice, and a timeout leaves us not knowing where the device
+    // is, so the whole command is started over.
+    if (status == transfer_resend) {
+      current_->sent--;
+    } else {
+      current_->sent = 0;
+    }
+    if (!send_next_byte()) {
+      complete(request_failed);
     }
+  } else if (current_->sent > send) {
+    complete(request_done);
+  } else if (!send_next_byte()) {
+    complete(request_failed);
   }
+}
 
-  enable_interrupt();
-  return true;
+bool ps2_command(uint16_t command, uint8_t* args, uint8_t* result) {
+  request r = {command, args, result, nullptr, request_pending, 0, 0};
+  if (!submit(&r)) {
+    return false;
+  }
+
+  while (r.status == request_pending) {
+    poll();
+  }
+  return r.status == request_done;
 }
 
-void reset() { ps2_command(PSMOUSE_CMD_RESET_BAT, nullptr, nullptr); }
+bool reset() { return ps2_command(PSMOUSE_CMD_RESET_BAT, nullptr, nullptr); }
+
+bool enable() { return ps2_command(PSMOUSE_CMD_ENABLE, nullptr, nullptr); }
 
-void enable() { ps2_command(PSMOUSE_CMD_ENABLE, nullptr, nullptr); }
+bool disable() { return ps2_command(PSMOUSE_CMD_DISABLE, nullptr, nullptr); }
 
-void disable() { ps2_command(PSMOUSE_CMD_DISABLE, nullptr, nullptr); }
+};  // namespace ps2
 
-};  // namespace ps2
\ No newline at end of file
+ISR(TIMER1_COMPA_vect) { ps2::bit_timeout(); }
@@ -35,12 +35,73 @@ namespace ps2 {
 #define PSMOUSE_CMD_SETRES 0x10e8
 #define PSMOUSE_CMD_GETINFO 0x03e9
 
-bool write_byte(uint8_t data);
-void begin(uint8_t clock_pin, uint8_t data_pin, void (*byte_received)(uint8_t));
+enum transfer_status : uint8_t {
+  transfer_idle,
+  transfer_busy,
+  transfer_done,
+  // The device asked for the byte to be sent again.
+  transfer_resend,
+  // The device answered with ERROR or a corrupt byte, didn't answer in time
+  // or the bus failed.
+  transfer_error,
+};
+
+// Starts sending a byte to the device and returns without waiting. The clock
+// interrupt shifts the bits out and collects the ACK plus `receive` response
+// bytes. Returns false if another transfer is in progress.
+bool begin_transfer(uint8_t data, uint8_t receive);
+// Returns the state of the current transfer. Once it returns transfer_done,
+// the response bytes are copied to `result` and the next transfer can begin.
+transfer_status poll_transfer(uint8_t* result);
+
+// Synchronous version. Interrupts stay enabled while waiting. The byte is
+// sent again if the device doesn't ACK it, a few times at most.
+bool write_byte(uint8_t data, uint8_t* result = nullptr, uint8_t receive = 0);
+// byte_received is called from the interrupt handler with each byte from the
+// device and the Timer1 tick at its stop bit. error is set if the byte has a
+// framing or parity error, or if it was cut short because the clock stopped.
+// Such a byte can't be trusted.
+void begin(uint8_t clock_pin, uint8_t data_pin,
+           void (*byte_received)(uint8_t data, uint16_t time, bool error));
+
+// Timer1 runs freely and wraps around every 262ms. Differences between two
+// ticks are valid as long as they are less than that apart.
+const uint8_t us_per_tick = 4;
+uint16_t ticks();
+
+enum request_status : uint8_t {
+  request_pending,
+  request_done,
+  request_failed,
+};
+
+// A command queued with submit(). The command encodes the number of argument
+// and response bytes, like PSMOUSE_CMD_*. args and result must stay valid until
+// the request completes.
+struct request {
+  uint16_t command;
+  uint8_t* args;
+  uint8_t* result;
+  // Optional. Called from poll() when the request completes.
+  void (*callback)(request*);
+  volatile request_status status;
+  // Number of bytes sent so far and retries made. Used internally.
+  uint8_t sent;
+  uint8_t retries;
+};
+
+// Queues a request without blocking. Returns false if the queue is full.
+bool submit(request* r);
+// Sends queued requests one byte at a time and completes them. Must be called
+// from loop(). A new request is only started between two packets, so streaming
+// isn't interrupted in the middle of a packet.
+void poll();
+// Submits a command and waits for it to complete. Returns false if the device
+// didn't acknowledge it even after retries.
 bool ps2_command(uint16_t command, uint8_t* args, uint8_t* result);
-void reset();
-void enable();
-void disable();
+bool reset();
+bool enable();
+bool disable();
 }  // namespace ps2
 
 #endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+// Compiler barrier. Makes sure the payload of a slot is written (or read)
+// before the index that hands the slot over to the other side is updated.
+// Enough with a single core. Host tests running both sides on threads define
+// it as a fence.
+#ifndef QUEUE_BARRIER
+#define QUEUE_BARRIER() asm volatile("" ::: "memory")
+#endif
+
+// A lock-free queue shared by exactly one producer and one consumer, e.g. an
+// interrupt handler and loop(). The producer only ever writes m_head and the
+// consumer only ever writes m_tail. Both are free running 8-bit counters, which
+// AVR reads and writes atomically, so neither side needs to disable interrupts.
+template <class T, uint8_t N>
+class SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+  static_assert(N <= 128, "N must fit in an 8-bit index");
+
+ private:
+  T m_buffer[N];
+  volatile uint8_t m_head;
+  volatile uint8_t m_tail;
+  // Number of items dropped because the queue was full. Only written by the
+  // producer.
+  volatile uint16_t m_overflows;
+
+ public:
+  inline SpscQueue() : m_head(0), m_tail(0), m_overflows(0) {}
+
+  bool empty() const { return m_head == m_tail; }
+  uint8_t size() const { return m_head - m_tail; }
+
+  uint16_t overflows() const {
+    // The counter is 16-bit and may be updated by the producer in the middle
+    // of the read. Read until two consecutive values agree.
+    uint16_t value;
+    do {
+      value = m_overflows;
+    } while (value != m_overflows);
+    return value;
+  }
+
+  // Producer only.
+  bool push_back(const T& item) {
+    T* slot = reserve();
+    if (slot == nullptr) {
+      return false;
+    }
+
+    *slot = item;
+    commit();
+    return true;
+  }
+
+  // Producer only. Returns the slot the next item is to be written to in
+  // place, or nullptr if the queue is full. The slot is handed over to the
+  // consumer by commit(). Calling reserve() again without commit() returns the
+  // same slot.
+  T* reserve() {
+    uint8_t head = m_head;
+    if ((uint8_t)(head - m_tail) == N) {
+      m_overflows++;
+      return nullptr;
+    }
+    // Don't write the slot before seeing that the consumer is done with it.
+    QUEUE_BARRIER();
+    return &m_buffer[head & (N - 1)];
+  }
+
+  void commit() {
+    QUEUE_BARRIER();
+    m_head = m_head + 1;
+  }
+
+  // Consumer only. The oldest item, read in place. The producer doesn't touch
+  // it until pop_front() is called. Undefined if the queue is empty.
+  const T& front() const {
+    // Don't read the slot before the check that it was committed.
+    QUEUE_BARRIER();
+    return m_buffer[m_tail & (N - 1)];
+  }
+
+  void pop_front() {
+    if (empty()) {
+      return;
+    }
+
+    QUEUE_BARRIER();
+    m_tail = m_tail + 1;
+  }
+};
+#endif
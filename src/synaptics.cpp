@@ -1,40 +1,69 @@
 #include <Arduino.h>
+#include "capture.h"
 #include "synaptics.h"
 
 namespace synaptics {
 
-int units_per_mm_x;
-int units_per_mm_y;
+// Until the touchpad reports its resolution, assume the one this firmware was
+// written for.
+int units_per_mm_x = known_model<0x0887>::units_per_mm_x;
+int units_per_mm_y = known_model<0x0887>::units_per_mm_y;
 uint8_t clickpad_type;
+uint16_t model = 0;
 
-void special_command(uint8_t command) {
+bool special_command(uint8_t command) {
   // Reference: 4.2. TouchPad special command sequences
   uint8_t resolution;
   for (int i = 6; i >= 0; i -= 2) {
     resolution = (command >> i) & 0x03;
-    ps2::ps2_command(PSMOUSE_CMD_SETRES, &resolution, nullptr);
+    if (!ps2::ps2_command(PSMOUSE_CMD_SETRES, &resolution, nullptr)) {
+      return false;
+    }
   }
+  return true;
 }
 
-void status_request(uint8_t arg, uint8_t* result) {
+bool status_request(uint8_t arg, uint8_t* result) {
   // Reference: 4.4. Information queries
-  special_command(arg);
-  ps2::ps2_command(PSMOUSE_CMD_GETINFO, nullptr, result);
+  return special_command(arg) &&
+         ps2::ps2_command(PSMOUSE_CMD_GETINFO, nullptr, result);
+}
+
+namespace {
+// Text would corrupt the binary stream of a capture.
+void print_line(const char* text) {
+  if (!capture::enabled()) {
+    Serial.println(text);
+  }
 }
 
-void init() {
+bool query_info() {
   uint8_t result[3];
   char buffer[256];
 
-  Serial.println("TouchPad info:");
+  print_line("TouchPad info:");
 
-  synaptics::status_request(0x00, result);
+  if (!synaptics::status_request(0x00, result)) {
+    print_line("  Identify query failed.");
+    return false;
+  }
   uint8_t infoMajor = result[2] & 0x0F;
   uint8_t infoMinor = result[0];
   sprintf(buffer, "  Version: %u.%u", infoMajor, infoMinor);
-  Serial.println(buffer);
+  print_line(buffer);
+
+  if (!synaptics::status_request(0x01, result)) {
+    print_line("  Model query failed.");
+    return false;
+  }
+  model = (uint16_t)(result[0] >> 2) << 8 | result[1];
+  sprintf(buffer, "  Model: 0x%04X", model);
+  print_line(buffer);
 
-  synaptics::status_request(0x02, result);
+  if (!synaptics::status_request(0x02, result)) {
+    print_line("  Capabilities query failed.");
+    return false;
+  }
   bool capExtended = result[0] & 0x80;
   if (capExtended) {
     int nExtendedQueries = (result[0] >> 4) & 0x07;
@@ -51,17 +80,26 @@ void init() {
             "  Multi-Finger: %u\n  Palm Detection: %u",
             nExtendedQueries, middleButton, fourButtons, multiFinger,
             palmDetect);
-    Serial.println(buffer);
+    print_line(buffer);
   }
 
-  synaptics::status_request(0x08, result);
-  units_per_mm_x = result[0];
-  units_per_mm_y = result[2];
+  if (!synaptics::status_request(0x08, result)) {
+    print_line("  Resolutions query failed.");
+    return false;
+  }
+  // Touchpads that don't support the query answer 0.
+  if (result[0] != 0 && result[2] != 0) {
+    units_per_mm_x = result[0];
+    units_per_mm_y = result[2];
+  }
   sprintf(buffer, "  X units per mm: %d\n  Y units per mm: %d", units_per_mm_x,
           units_per_mm_y);
-  Serial.println(buffer);
+  print_line(buffer);
 
-  synaptics::status_request(0x0C, result);
+  if (!synaptics::status_request(0x0C, result)) {
+    print_line("  Continued capabilities query failed.");
+    return false;
+  }
   bool coveredPadGest = result[0] & 0x80;
   clickpad_type = (result[0] >> 4) & 0x01 | (result[1] << 1) & 0x02;
   char* clickPadInfo[4] = {"Not a ClickPad", "1-button ClickPad",
@@ -71,8 +109,11 @@ void init() {
   sprintf(buffer,
           "  Covered Pad Gesture: %u\n  ClickPad type: %s\n  Adv Gesture: %u",
           coveredPadGest, clickPadInfo[clickpad_type], advGest);
-  Serial.println(buffer);
+  print_line(buffer);
+  return true;
+}
 
+bool set_mode() {
   // Reference: 4.3. Mode byte
   // Somehow, I couldn't get the touchpad to report extended W mode packets.
   // After some research, I found the solution in VoodooPS2 driver (Touchpad
@@ -86,20 +127,31 @@ void init() {
 
   uint8_t sample_rate = 0x14;
 
-  ps2::disable();
+  bool ok = ps2::disable() &&
+            ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr) &&
+            ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr) &&
+            synaptics::special_command(0xC5) &&
+            ps2::ps2_command(PSMOUSE_CMD_SETRATE, &sample_rate, nullptr);
 
-  ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr);
-  ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr);
-  synaptics::special_command(0xC5);
-  sample_rate = 0x14;
-  ps2::ps2_command(PSMOUSE_CMD_SETRATE, &sample_rate, nullptr);
-
-  ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr);
-  ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr);
-  synaptics::special_command(0x03);
   sample_rate = 0xC8;
-  ps2::ps2_command(PSMOUSE_CMD_SETRATE, &sample_rate, nullptr);
+  ok = ok && ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr) &&
+       ps2::ps2_command(PSMOUSE_CMD_SETSCALE11, nullptr, nullptr) &&
+       synaptics::special_command(0x03) &&
+       ps2::ps2_command(PSMOUSE_CMD_SETRATE, &sample_rate, nullptr);
+
+  // Re-enable streaming even if setting the mode failed, so that the touchpad
+  // still works in whatever mode it is in.
+  ok = ps2::enable() && ok;
+  if (!ok) {
+    print_line("  Setting the mode failed.");
+  }
+  return ok;
+}
+}  // namespace
 
-  ps2::enable();
+bool init() {
+  // Set the mode even if a query failed, so that streaming is always enabled.
+  bool ok = query_info();
+  return set_mode() && ok;
 }
 }  // namespace synaptics
\ No newline at end of file
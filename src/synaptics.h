@@ -4,13 +4,79 @@
 #include "ps2.h"
 
 namespace synaptics {
+// Reference: 3.2. Absolute mode packets
+const uint8_t packet_size = 6;
+struct packet {
+  uint8_t bytes[packet_size];
+  // ps2::ticks() when the last byte arrived.
+  uint16_t time;
+};
+
+// A finger, decoded from a packet with byte and word operations only. AVR has
+// no barrel shifter, so shifting a 64-bit packet is a loop per bit.
+struct contact {
+  int x;
+  int y;
+  uint8_t z;
+  uint8_t w;
+  bool button;
+};
+
+// Reference: Section 3.2.1, Figure 3-4
+inline uint8_t decode_w(const packet& p) {
+  return (p.bytes[3] >> 2) & 0x01 | (p.bytes[0] >> 1) & 0x02 |
+         (p.bytes[0] >> 2) & 0x0C;
+}
+
+inline contact decode_primary(const packet& p) {
+  contact c;
+  c.x = (p.bytes[3] & 0x10) << 8 | (p.bytes[1] & 0x0F) << 8 | p.bytes[4];
+  c.y = (p.bytes[3] & 0x20) << 7 | (p.bytes[1] & 0xF0) << 4 | p.bytes[5];
+  c.z = p.bytes[2];
+  c.w = decode_w(p);
+  c.button = p.bytes[3] & 0x01;
+  return c;
+}
+
+// Extended W mode packets, i.e. w == 2. Reference: Section 3.2.9
+inline uint8_t extended_packet_code(const packet& p) { return p.bytes[5] >> 4; }
+
+// Packet code 1. Positions have half the resolution of a primary packet.
+// Reference: Section 3.2.9.2, Figure 3-14
+inline contact decode_secondary(const packet& p) {
+  contact c;
+  c.x = (p.bytes[4] & 0x0F) << 9 | p.bytes[1] << 1;
+  c.y = (p.bytes[4] & 0xF0) << 5 | p.bytes[2] << 1;
+  c.z = (p.bytes[3] << 1) & 0x60 | (p.bytes[5] << 1) & 0x1C |
+        (p.bytes[4] >> 7) & 0x01;
+  c.w = 2;
+  c.button = false;
+  return c;
+}
+
+// From the resolutions query. The T1320A's if it failed.
 extern int units_per_mm_x;
 extern int units_per_mm_y;
 extern uint8_t clickpad_type;
+// From query 0x01, as listed in README.md. 0 until init() succeeds.
+extern uint16_t model;
+
+// Touchpads known at compile time, by model. Each specialization has the
+// resolution the firmware can assume for it.
+template <uint16_t Model>
+struct known_model;
+
+// T1320A, from an HP Envy Sleekbook 6.
+template <>
+struct known_model<0x0887> {
+  static const int units_per_mm_x = 47;
+  static const int units_per_mm_y = 66;
+};
 
-void special_command(uint8_t command);
-void status_request(uint8_t arg, uint8_t* result);
-void init();
+// These return false if the touchpad didn't acknowledge a command.
+bool special_command(uint8_t command);
+bool status_request(uint8_t arg, uint8_t* result);
+bool init();
 }  // namespace synaptics
 
 template <class T, int N>
@@ -50,7 +116,7 @@ class RingBuffer {
     m_buffer[m_back] = item;
     m_back = (m_back + 1) % N;
     m_size++;
-    return;
+    return true;
   }
 
   T& operator[](int i) {
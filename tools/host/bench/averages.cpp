@@ -0,0 +1,98 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Compares the cost of SimpleAverage and of the filters in src/filters.h on
+// the host, fed with the same positions. Each sample gets the previous and
+// the new average, as parse_primary_packet() needs.
+
+#include <time.h>
+
+#include "Arduino.h"
+#include "../../../src/filters.h"
+#include "../../../src/synaptics.h"
+
+namespace {
+const int sample_count = 1 << 20;
+const int rounds = 20;
+int samples[sample_count];
+volatile int sink;
+
+double seconds() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+template <class Average>
+double average_then_filter() {
+  Average average;
+  double started = seconds();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < sample_count; i++) {
+      int previous = average.average();
+      int current = average.filter(samples[i]);
+      sink = current - previous;
+    }
+  }
+  return (seconds() - started) * 1e9 / rounds / sample_count;
+}
+
+template <class Average>
+double update() {
+  Average average;
+  double started = seconds();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < sample_count; i++) {
+      averages<int> result = average.update(samples[i]);
+      sink = result.current - result.previous;
+    }
+  }
+  return (seconds() - started) * 1e9 / rounds / sample_count;
+}
+}  // namespace
+
+int main() {
+  // A finger wandering around, as raw positions.
+  int position = 3000;
+  srand(1);
+  for (int i = 0; i < sample_count; i++) {
+    position = constrain(position + rand() % 41 - 20, 1, 6000);
+    samples[i] = position;
+  }
+
+  printf("%-44s %.2f ns per sample\n", "SimpleAverage<int, 5>",
+         average_then_filter<SimpleAverage<int, 5> >());
+  printf("%-44s %.2f ns per sample\n", "PowerOfTwoAverage<int, 4>",
+         update<PowerOfTwoAverage<int, 4> >());
+  printf("%-44s %.2f ns per sample\n", "PowerOfTwoAverage<int, 8>",
+         update<PowerOfTwoAverage<int, 8> >());
+  printf("%-44s %.2f ns per sample\n", "ExponentialAverage<int, 2>",
+         update<ExponentialAverage<int, 2> >());
+  printf("%-44s %.2f ns per sample\n", "OneEuroFilter<int, 26, 8>",
+         update<OneEuroFilter<int, 26, 8> >());
+  printf("%-44s %.2f ns per sample\n", "AlphaBetaTracker<int, 128, 43, 1>",
+         update<AlphaBetaTracker<int, 128, 43, 1> >());
+  printf("%-44s %.2f ns per sample\n",
+         "MedianOf3<int, PowerOfTwoAverage<int, 4> >",
+         update<MedianOf3<int, PowerOfTwoAverage<int, 4> > >());
+  return 0;
+}
@@ -0,0 +1,57 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "drivers.h"
+
+#include "../../../src/ps2.h"
+#include "../../../src/synaptics.h"
+
+namespace drivers {
+void (*byte_received)(uint8_t, uint16_t, bool) = nullptr;
+uint16_t ticks = 0;
+int units_per_mm_x = 0;
+int units_per_mm_y = 0;
+uint16_t model = 0;
+}  // namespace drivers
+
+namespace ps2 {
+void begin(uint8_t, uint8_t, void (*byte_received)(uint8_t, uint16_t, bool)) {
+  drivers::byte_received = byte_received;
+}
+bool reset() { return true; }
+void poll() {}
+uint16_t ticks() { return drivers::ticks; }
+}  // namespace ps2
+
+namespace synaptics {
+int units_per_mm_x;
+int units_per_mm_y;
+uint8_t clickpad_type = 1;
+uint16_t model;
+
+bool init() {
+  units_per_mm_x = drivers::units_per_mm_x;
+  units_per_mm_y = drivers::units_per_mm_y;
+  model = drivers::model;
+  return true;
+}
+}  // namespace synaptics
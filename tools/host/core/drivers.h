@@ -0,0 +1,44 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Stand-ins for the parts of src/ps2.cpp and src/synaptics.cpp that talk to
+// the touchpad, so that touchpad.ino can run on a host without one. A tool
+// sets the resolution before calling setup(), then feeds bytes through
+// byte_received.
+
+#ifndef DRIVERS_H
+#define DRIVERS_H
+
+#include <stdint.h>
+
+namespace drivers {
+// The callback passed to ps2::begin().
+extern void (*byte_received)(uint8_t data, uint16_t time, bool error);
+// Returned by ps2::ticks().
+extern uint16_t ticks;
+// Reported by synaptics::init().
+extern int units_per_mm_x;
+extern int units_per_mm_y;
+extern uint16_t model;
+}  // namespace drivers
+
+#endif
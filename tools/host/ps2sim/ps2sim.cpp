@@ -0,0 +1,420 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Runs src/ps2.cpp on the host against a simulated PS/2 device, driven by a
+// script. See README.md for the script commands.
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "shim.h"
+#include "../../../src/errors.h"
+#include "../../../src/ps2.h"
+
+namespace {
+
+const uint8_t clock_pin = 0;
+const uint8_t data_pin = 1;
+
+uint8_t odd_parity(uint8_t data) {
+  uint8_t parity = 1;
+  for (int i = 0; i < 8; i++) {
+    parity ^= (data >> i) & 0x01;
+  }
+  return parity;
+}
+
+// A PS/2 device. It generates the clock, sends queued bytes to the host and
+// receives bytes from the host, answering each of them.
+class device : public shim::bus_device {
+ public:
+  struct outgoing {
+    uint8_t data;
+    // Clock edge to leave out, -1 for none.
+    int missed_edge;
+    bool bad_parity;
+  };
+
+  // An answer to a byte from the host.
+  struct reply {
+    std::vector<uint8_t> bytes;
+    // Index of the byte sent with a wrong parity bit, -1 for none.
+    int bad_parity;
+  };
+
+  unsigned long period_us = 80;
+  unsigned long gap_us = 100;
+  // How long the device takes to answer a byte from the host.
+  unsigned long response_delay_us = 500;
+
+  std::deque<outgoing> queue;
+  // Scripted answers to the next bytes from the host. FA if there's none.
+  std::deque<reply> replies;
+  std::vector<uint8_t> host_bytes;
+  unsigned long bytes_sent = 0;
+  unsigned long bytes_aborted = 0;
+
+  bool idle() const { return queue.empty() && state_ == idle_state; }
+
+  void tick(unsigned long now, bool clock, bool data, bool* pull_clock_low,
+            bool* pull_data_low) override {
+    bool host_clock_low = !clock && !clock_low_;
+    switch (state_) {
+      case idle_state:
+        if (host_clock_low) {
+          state_ = inhibited_state;
+        } else if (!queue.empty() && now >= next_send_) {
+          start_sending(now);
+        }
+        break;
+      case sending_state:
+        if (host_clock_low && bit_ < 10) {
+          // The host inhibits the bus. The byte is sent again later.
+          bytes_aborted++;
+          clock_low_ = false;
+          data_low_ = false;
+          state_ = inhibited_state;
+        } else {
+          send_step(now);
+        }
+        break;
+      case inhibited_state:
+        if (clock) {
+          if (!data) {
+            // Request to send.
+            state_ = receiving_state;
+            bit_ = 0;
+            received_ = 0;
+            bit_started_ = now + period_us / 2;
+          } else {
+            state_ = idle_state;
+            next_send_ = now + gap_us;
+          }
+        }
+        break;
+      case receiving_state:
+        receive_step(now, data);
+        break;
+    }
+
+    *pull_clock_low = clock_low_;
+    *pull_data_low = data_low_;
+  }
+
+ private:
+  enum state { idle_state, sending_state, inhibited_state, receiving_state };
+
+  state state_ = idle_state;
+  unsigned long next_send_ = 0;
+  unsigned long bit_started_ = 0;
+  int bit_ = 0;
+  uint16_t frame_ = 0;
+  uint16_t received_ = 0;
+  bool clock_low_ = false;
+  bool data_low_ = false;
+  // Bytes of the last answer at the front of the queue, not sent yet.
+  size_t answer_left_ = 0;
+
+  void start_sending(unsigned long now) {
+    const outgoing& item = queue.front();
+    uint8_t parity = odd_parity(item.data) ^ (item.bad_parity ? 1 : 0);
+    // Start bit 0, payload LSB first, parity, stop bit 1.
+    frame_ = (item.data << 1) | (parity << 9) | (1 << 10);
+    bit_ = 0;
+    state_ = sending_state;
+    begin_sending_bit(now);
+  }
+
+  void begin_sending_bit(unsigned long now) {
+    data_low_ = !((frame_ >> bit_) & 0x01);
+    bit_started_ = now;
+  }
+
+  // Each bit: data is set, the clock goes low half a period later and high
+  // again at the end of the period. The host samples on the falling edge.
+  void send_step(unsigned long now) {
+    unsigned long elapsed = now - bit_started_;
+    if (elapsed == period_us / 2) {
+      clock_low_ = queue.front().missed_edge != bit_;
+    } else if (elapsed >= period_us) {
+      clock_low_ = false;
+      if (++bit_ < 11) {
+        begin_sending_bit(now);
+        return;
+      }
+      data_low_ = false;
+      queue.pop_front();
+      if (answer_left_ > 0) {
+        answer_left_--;
+      }
+      bytes_sent++;
+      next_send_ = now + gap_us;
+      state_ = idle_state;
+    }
+  }
+
+  // Each bit: the clock goes low, the host sets data, and the device samples
+  // it when the clock goes high again half a period later. Bits 0-7 payload,
+  // 8 parity, 9 stop, 10 is the ACK from the device.
+  void receive_step(unsigned long now, bool data) {
+    if (now < bit_started_) {
+      return;
+    }
+
+    unsigned long elapsed = now - bit_started_;
+    if (elapsed == 0) {
+      clock_low_ = true;
+      data_low_ = bit_ == 10;
+    } else if (elapsed == period_us / 2) {
+      clock_low_ = false;
+      if (bit_ < 10) {
+        received_ |= (data ? 1 : 0) << bit_;
+      }
+    } else if (elapsed >= period_us) {
+      if (++bit_ < 11) {
+        bit_started_ = now + 1;
+        return;
+      }
+      data_low_ = false;
+      byte_received(now);
+    }
+  }
+
+  void byte_received(unsigned long now) {
+    uint8_t data = received_ & 0xFF;
+    uint8_t parity = (received_ >> 8) & 0x01;
+    // The rest of an earlier answer is dropped, as the host has moved on.
+    queue.erase(queue.begin(), queue.begin() + answer_left_);
+    reply answer = {std::vector<uint8_t>(), -1};
+    if (parity != odd_parity(data)) {
+      answer.bytes.push_back(0xFE);
+    } else {
+      host_bytes.push_back(data);
+      if (!replies.empty()) {
+        answer = replies.front();
+        replies.pop_front();
+      } else {
+        answer.bytes.push_back(0xFA);
+      }
+    }
+
+    for (size_t i = answer.bytes.size(); i > 0; i--) {
+      outgoing item = {answer.bytes[i - 1], -1,
+                       (int)i - 1 == answer.bad_parity};
+      queue.push_front(item);
+    }
+    answer_left_ = answer.bytes.size();
+    next_send_ = now + response_delay_us;
+    state_ = idle_state;
+  }
+};
+
+device device_;
+std::vector<uint8_t> received;
+unsigned long lost = 0;
+bool verbose = false;
+
+void byte_received(uint8_t data, uint16_t time, bool error) {
+  if (error) {
+    lost++;
+  } else {
+    received.push_back(data);
+  }
+  if (verbose) {
+    printf("%10lu us: received %02X, tick %5u%s\n", shim::now(), data, time,
+           error ? ", error" : "");
+  }
+}
+
+// Runs the bus until the device has nothing more to send.
+void drain() {
+  while (!device_.idle()) {
+    shim::advance(100);
+    ps2::poll();
+  }
+}
+
+const char* error_names[] = {
+    "start bit", "parity",        "stop bit",         "timeout",
+    "line control", "no ack",     "unexpected byte0", "unexpected byte3",
+    "packet overflow",
+};
+static_assert(sizeof(error_names) / sizeof(error_names[0]) ==
+                  errors::code_count,
+              "error_names is out of date");
+
+void print_summary(unsigned long started_us) {
+  unsigned long elapsed = shim::now() - started_us;
+  printf("simulated time:   %lu us\n", elapsed);
+  printf("device sent:      %lu bytes, %lu aborted\n", device_.bytes_sent,
+         device_.bytes_aborted);
+  printf("host received:    %zu bytes, %lu with errors", received.size(),
+         lost);
+  if (elapsed > 0) {
+    printf(", %.0f bytes/s", received.size() * 1e6 / elapsed);
+  }
+  printf("\n");
+  printf("device received:  %zu bytes\n", device_.host_bytes.size());
+  if (shim::interrupt_calls() > 0) {
+    printf("interrupts:       %lu, %.1f ns each on this host, 99%% within %lu "
+           "ns\n",
+           shim::interrupt_calls(),
+           (double)shim::interrupt_nanoseconds() / shim::interrupt_calls(),
+           shim::interrupt_percentile_nanoseconds(99));
+  }
+  for (int i = 0; i < errors::code_count; i++) {
+    uint16_t count = errors::count((errors::code)i);
+    if (count > 0) {
+      printf("error %-16s %u\n", error_names[i], count);
+    }
+  }
+}
+
+std::vector<uint8_t> read_bytes(std::istringstream& in) {
+  std::vector<uint8_t> bytes;
+  std::string token;
+  while (in >> token) {
+    bytes.push_back(strtoul(token.c_str(), nullptr, 16));
+  }
+  return bytes;
+}
+
+int run_script(std::istream& script) {
+  int next_missed_edge = -1;
+  bool next_bad_parity = false;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(script, line)) {
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream in(line);
+    std::string command;
+    if (!(in >> command)) {
+      continue;
+    }
+
+    if (command == "period") {
+      in >> device_.period_us;
+    } else if (command == "gap") {
+      in >> device_.gap_us;
+    } else if (command == "glitch") {
+      in >> next_missed_edge;
+    } else if (command == "parity") {
+      next_bad_parity = true;
+    } else if (command == "send" || command == "repeat") {
+      int times = 1;
+      if (command == "repeat") {
+        in >> times;
+      }
+      std::vector<uint8_t> bytes = read_bytes(in);
+      for (int n = 0; n < times; n++) {
+        for (size_t i = 0; i < bytes.size(); i++) {
+          device::outgoing item = {bytes[i], next_missed_edge,
+                                   next_bad_parity};
+          device_.queue.push_back(item);
+          next_missed_edge = -1;
+          next_bad_parity = false;
+        }
+      }
+    } else if (command == "respond") {
+      device::reply answer = {std::vector<uint8_t>(), -1};
+      in >> std::ws;
+      if (in.peek() == 'p') {
+        std::string option;
+        in >> option >> answer.bad_parity;
+      }
+      answer.bytes = read_bytes(in);
+      device_.replies.push_back(answer);
+    } else if (command == "command") {
+      // The command code is 16-bit, e.g. 03e9 for GETINFO, followed by the
+      // argument bytes.
+      std::string code_token;
+      if (!(in >> code_token)) {
+        fprintf(stderr, "line %d: command needs a code\n", line_number);
+        return 1;
+      }
+      uint16_t code = strtoul(code_token.c_str(), nullptr, 16);
+      std::vector<uint8_t> args = read_bytes(in);
+      uint8_t result[16] = {};
+      unsigned long started = shim::now();
+      bool ok = ps2::ps2_command(code, args.data(), result);
+      printf("command %04X: %s in %lu us", code, ok ? "ok" : "failed",
+             shim::now() - started);
+      for (int i = 0; i < ((code >> 8) & 0x0F); i++) {
+        printf(" %02X", result[i]);
+      }
+      printf("\n");
+    } else if (command == "run") {
+      unsigned long us = 0;
+      in >> us;
+      shim::advance(us);
+    } else if (command == "drain") {
+      drain();
+    } else {
+      fprintf(stderr, "line %d: unknown command %s\n", line_number,
+              command.c_str());
+      return 1;
+    }
+
+    while (errors::print_pending()) {
+    }
+  }
+
+  drain();
+  while (errors::print_pending()) {
+  }
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == nullptr) {
+    fprintf(stderr, "usage: %s [-v] script\n", argv[0]);
+    return 2;
+  }
+
+  std::ifstream script(path);
+  if (!script) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 2;
+  }
+
+  shim::connect(&device_, clock_pin, data_pin);
+  ps2::begin(clock_pin, data_pin, byte_received);
+  unsigned long started = shim::now();
+  int result = run_script(script);
+  print_summary(started);
+  return result;
+}
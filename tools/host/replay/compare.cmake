@@ -0,0 +1,15 @@
+# Replays TRACE with REPLAY and compares the reports with the EXPECTED file.
+# Run with cmake -P, as CTest does.
+
+execute_process(
+  COMMAND ${REPLAY} ${TRACE}
+  OUTPUT_VARIABLE actual
+  ERROR_VARIABLE log
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "replay failed:\n${log}")
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT actual STREQUAL expected)
+  message(FATAL_ERROR "reports differ from ${EXPECTED}:\n${actual}")
+endif()
@@ -0,0 +1,405 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Replays a packet trace through the logic in touchpad.ino and prints the HID
+// reports it sends, one per line. See README.md for the trace format.
+
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "shim.h"
+#include "drivers.h"
+#include "../../../src/capture.h"
+#include "../../../src/profile.h"
+#include "../../../src/synaptics.h"
+
+void setup();
+void loop();
+void process_pending_packet(const synaptics::packet& raw);
+profile::path processed_path(const synaptics::packet& raw);
+
+namespace {
+struct trace_packet {
+  uint16_t time;
+  uint8_t bytes[synaptics::packet_size];
+};
+
+struct trace {
+  int units_per_mm_x = 0;
+  int units_per_mm_y = 0;
+  uint16_t model = 0;
+  std::vector<trace_packet> packets;
+};
+
+trace trace_;
+size_t current_packet = 0;
+unsigned long report_count = 0;
+// Cursor movement reported while processing each packet, in HID units.
+std::vector<int> reported_x;
+std::vector<int> reported_y;
+
+void report_sent(uint8_t, const uint8_t* data, int) {
+  report_count++;
+  reported_x[current_packet] += (int8_t)data[1];
+  reported_y[current_packet] += (int8_t)data[2];
+  printf("%zu %u %d %d %d\n", current_packet, data[0], (int8_t)data[1],
+         (int8_t)data[2], (int8_t)data[3]);
+}
+
+bool read_text_trace(std::istream& in, trace& t) {
+  std::string line;
+  int line_number = 0;
+  while (std::getline(in, line)) {
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string key;
+    if (!(fields >> key)) {
+      continue;
+    }
+
+    if (key == "units_per_mm") {
+      fields >> t.units_per_mm_x >> t.units_per_mm_y;
+    } else if (key == "model") {
+      std::string model;
+      fields >> model;
+      t.model = strtoul(model.c_str(), nullptr, 16);
+    } else if (isdigit(key[0])) {
+      trace_packet p;
+      p.time = strtoul(key.c_str(), nullptr, 10);
+      for (int i = 0; i < synaptics::packet_size; i++) {
+        std::string byte;
+        if (!(fields >> byte)) {
+          fprintf(stderr, "line %d: packet is too short\n", line_number);
+          return false;
+        }
+        p.bytes[i] = strtoul(byte.c_str(), nullptr, 16);
+      }
+      t.packets.push_back(p);
+    }
+    // Unknown keys are ignored, so that newer traces can still be read.
+  }
+  return true;
+}
+
+// A capture from the serial port. See "Capturing packets" in the top level
+// README. It has no metadata, so the resolution has to be given separately.
+bool read_capture(std::istream& in, trace& t) {
+  capture::record r;
+  while (in.read(reinterpret_cast<char*>(&r), sizeof(r))) {
+    if (r.magic[0] != capture::magic0 || r.magic[1] != capture::magic1) {
+      fprintf(stderr, "capture is out of sync\n");
+      return false;
+    }
+    trace_packet p;
+    p.time = r.packet_time;
+    memcpy(p.bytes, r.packet, synaptics::packet_size);
+    t.packets.push_back(p);
+  }
+  return true;
+}
+
+void write_text_trace(const trace& t) {
+  printf("units_per_mm %d %d\n", t.units_per_mm_x, t.units_per_mm_y);
+  if (t.model != 0) {
+    printf("model %04x\n", t.model);
+  }
+  for (size_t i = 0; i < t.packets.size(); i++) {
+    const trace_packet& p = t.packets[i];
+    printf("%u", p.time);
+    for (int j = 0; j < synaptics::packet_size; j++) {
+      printf(" %02x", p.bytes[j]);
+    }
+    printf("\n");
+  }
+}
+
+// Lag and jitter of the cursor, against the finger positions in a trace.
+// Only frames with exactly one finger, and the one before it, count.
+//
+// The lag is the delay, in frames, at which the reported movement correlates
+// best with the finger movement, interpolated between frames. It includes the
+// report delay of touchpad.ino. The jitter is the average reported movement,
+// at that delay, for frames where the finger stayed within still_mm for the
+// last still_frames frames. That movement is also split by its direction
+// relative to the last finger movement: forward is overshoot, backward is the
+// correction.
+void print_metrics(const trace& t) {
+  const int max_lag = 20;
+  const float still_mm = 0.25F;
+  const int still_frames = 4;
+
+  size_t n = t.packets.size();
+  std::vector<bool> one_finger(n);
+  std::vector<int> x(n), y(n);
+  for (size_t i = 0; i < n; i++) {
+    synaptics::packet p;
+    memcpy(p.bytes, t.packets[i].bytes, synaptics::packet_size);
+    synaptics::contact c = synaptics::decode_primary(p);
+    one_finger[i] = c.z > 0 && c.w >= 4;
+    x[i] = c.x;
+    y[i] = c.y;
+  }
+
+  int lag = 0;
+  double best = -1;
+  double correlations[max_lag + 1];
+  for (int d = 0; d <= max_lag; d++) {
+    double product = 0, finger = 0, cursor = 0;
+    for (size_t i = 1; i + d < n; i++) {
+      if (!one_finger[i] || !one_finger[i - 1]) {
+        continue;
+      }
+      // HID y points down, the touchpad's y up.
+      double dx = x[i] - x[i - 1], dy = y[i] - y[i - 1];
+      double cx = reported_x[i + d], cy = -reported_y[i + d];
+      product += dx * cx + dy * cy;
+      finger += dx * dx + dy * dy;
+      cursor += cx * cx + cy * cy;
+    }
+    double correlation =
+        finger > 0 && cursor > 0 ? product / sqrt(finger * cursor) : 0;
+    correlations[d] = correlation;
+    if (correlation > best) {
+      best = correlation;
+      lag = d;
+    }
+  }
+  // Between frames, at the top of the parabola through the best delay and
+  // its neighbors.
+  double fractional_lag = lag;
+  if (lag > 0 && lag < max_lag) {
+    double before = correlations[lag - 1];
+    double after = correlations[lag + 1];
+    double curvature = before - 2 * best + after;
+    if (curvature < 0) {
+      fractional_lag += (before - after) / (2 * curvature);
+    }
+  }
+
+  int still_x = still_mm * t.units_per_mm_x;
+  int still_y = still_mm * t.units_per_mm_y;
+  long still = 0, moved = 0, forward = 0, backward = 0;
+  int direction_x = 0, direction_y = 0;
+  for (size_t i = still_frames; i + lag < n; i++) {
+    if (one_finger[i] && one_finger[i - 1] &&
+        (abs(x[i] - x[i - 1]) > still_x || abs(y[i] - y[i - 1]) > still_y)) {
+      direction_x = x[i] - x[i - 1];
+      direction_y = -(y[i] - y[i - 1]);
+    }
+    bool is_still = true;
+    for (int j = 0; j <= still_frames && is_still; j++) {
+      is_still = one_finger[i - j] &&
+                 abs(x[i - j] - x[i - still_frames]) <= still_x &&
+                 abs(y[i - j] - y[i - still_frames]) <= still_y;
+    }
+    if (is_still) {
+      still++;
+      moved += abs(reported_x[i + lag]) + abs(reported_y[i + lag]);
+      long along = (long)reported_x[i + lag] * direction_x +
+                   (long)reported_y[i + lag] * direction_y;
+      if (along > 0) {
+        forward += abs(reported_x[i + lag]) + abs(reported_y[i + lag]);
+      } else if (along < 0) {
+        backward += abs(reported_x[i + lag]) + abs(reported_y[i + lag]);
+      }
+    }
+  }
+
+  fprintf(stderr, "lag: %.2f frames (correlation %.2f)\n", fractional_lag,
+          best);
+  fprintf(stderr, "jitter: %.3f HID units per frame over %ld still frames\n",
+          still > 0 ? (double)moved / still : 0.0, still);
+  fprintf(stderr, "overshoot: %ld HID units forward, %ld backward\n", forward,
+          backward);
+}
+
+// The time stamp counter on x86, which counts at a constant rate close to the
+// nominal clock of the CPU. Nanoseconds elsewhere.
+#if defined(__x86_64__) || defined(__i386__)
+const char* const cycle_unit = "TSC cycles";
+uint64_t host_cycles() { return __rdtsc(); }
+#else
+const char* const cycle_unit = "ns";
+uint64_t host_cycles() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+// What the profiling build of the firmware measures on the device (see
+// src/profile.h): the cost of process_pending_packet() by path, here in host
+// cycles. The trace is replayed `rounds` times, with the packets handed
+// straight to process_pending_packet() so that nothing else is timed. The
+// reports are not printed.
+void print_profile(const trace& t, int rounds) {
+  static const char* const names[profile::path_count] = {
+      "idle", "tracking", "scrolling", "extended", "guest"};
+  struct path_stats {
+    unsigned long count = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    uint64_t total = 0;
+  } stats[profile::path_count];
+
+  for (int round = 0; round < rounds; round++) {
+    for (const trace_packet& p : t.packets) {
+      synaptics::packet packet;
+      memcpy(packet.bytes, p.bytes, synaptics::packet_size);
+      packet.time = p.time;
+      drivers::ticks = p.time;
+      uint64_t started = host_cycles();
+      process_pending_packet(packet);
+      uint64_t cycles = host_cycles() - started;
+
+      path_stats& s = stats[processed_path(packet)];
+      s.count++;
+      if (cycles < s.min) {
+        s.min = cycles;
+      }
+      if (cycles > s.max) {
+        s.max = cycles;
+      }
+      s.total += cycles;
+    }
+  }
+
+  printf("%-10s %8s %8s %8s %8s (%s)\n", "path", "packets", "min", "mean",
+         "max", cycle_unit);
+  for (int i = 0; i < profile::path_count; i++) {
+    const path_stats& s = stats[i];
+    if (s.count == 0) {
+      continue;
+    }
+    printf("%-10s %8lu %8llu %8llu %8llu\n", names[i], s.count,
+           (unsigned long long)s.min, (unsigned long long)(s.total / s.count),
+           (unsigned long long)s.max);
+  }
+}
+
+double seconds() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  bool convert = false;
+  bool metrics = false;
+  int profile_rounds = 0;
+  int units_x = 0, units_y = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-t") == 0) {
+      convert = true;
+    } else if (strcmp(argv[i], "-m") == 0) {
+      metrics = true;
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      profile_rounds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-u") == 0 && i + 2 < argc) {
+      units_x = atoi(argv[++i]);
+      units_y = atoi(argv[++i]);
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == nullptr) {
+    fprintf(stderr,
+            "usage: %s [-t] [-m] [-p rounds] [-u units_per_mm_x "
+            "units_per_mm_y] trace\n",
+            argv[0]);
+    return 2;
+  }
+
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 2;
+  }
+  bool is_capture = in.peek() == capture::magic0;
+  if (!(is_capture ? read_capture(in, trace_) : read_text_trace(in, trace_))) {
+    return 1;
+  }
+  if (units_x != 0) {
+    trace_.units_per_mm_x = units_x;
+    trace_.units_per_mm_y = units_y;
+  }
+  if (trace_.units_per_mm_x == 0 || trace_.units_per_mm_y == 0) {
+    fprintf(stderr, "the resolution is unknown, use -u\n");
+    return 1;
+  }
+  drivers::units_per_mm_x = trace_.units_per_mm_x;
+  drivers::units_per_mm_y = trace_.units_per_mm_y;
+  drivers::model = trace_.model;
+
+  if (convert) {
+    write_text_trace(trace_);
+    return 0;
+  }
+
+  // Whatever the firmware prints goes to stderr, the reports to stdout.
+  shim::serial_output = stderr;
+  shim::report_sent = report_sent;
+  reported_x.assign(trace_.packets.size(), 0);
+  reported_y.assign(trace_.packets.size(), 0);
+  setup();
+
+  if (profile_rounds > 0) {
+    shim::report_sent = nullptr;
+    print_profile(trace_, profile_rounds);
+    return 0;
+  }
+
+  double started = seconds();
+  for (current_packet = 0; current_packet < trace_.packets.size();
+       current_packet++) {
+    const trace_packet& p = trace_.packets[current_packet];
+    drivers::ticks = p.time;
+    for (int i = 0; i < synaptics::packet_size; i++) {
+      drivers::byte_received(p.bytes[i], p.time, false);
+    }
+    // Once to process the packet, once more for the idle work.
+    loop();
+    loop();
+  }
+  double elapsed = seconds() - started;
+
+  fprintf(stderr, "%zu packets, %lu reports, %.3f us per packet\n",
+          trace_.packets.size(), report_count,
+          trace_.packets.empty() ? 0 : elapsed * 1e6 / trace_.packets.size());
+  if (metrics) {
+    print_metrics(trace_);
+  }
+  return 0;
+}
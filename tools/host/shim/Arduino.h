@@ -0,0 +1,156 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A thin stand-in for the Arduino core, so the firmware can be compiled and
+// run on a Linux host. Only what the firmware uses is provided. The AVR
+// registers are plain variables, and time is simulated: it only advances when
+// the firmware asks for it (millis(), micros(), delayMicroseconds()) or when
+// the host program calls shim::advance(). See shim.h.
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#define memcpy_P memcpy
+
+class __FlashStringHelper;
+#define F(string) (reinterpret_cast<const __FlashStringHelper*>(string))
+
+#define _BV(bit) (1 << (bit))
+
+// Status register. Only the global interrupt flag is simulated.
+#define SREG_I 7
+extern volatile uint8_t SREG;
+void cli();
+void sei();
+
+// Port D. Pins 0-7 all map to it.
+extern volatile uint8_t PIND;
+extern volatile uint8_t DDRD;
+extern volatile uint8_t PORTD;
+#define digitalPinToPort(pin) (4)
+#define portInputRegister(port) ((void)(port), &PIND)
+#define portModeRegister(port) ((void)(port), &DDRD)
+#define portOutputRegister(port) ((void)(port), &PORTD)
+#define digitalPinToBitMask(pin) ((uint8_t)_BV(pin))
+#define digitalPinToInterrupt(pin) (pin)
+
+// An interrupt flag register. Like on AVR, writing a 1 clears a flag.
+struct flag_register {
+  uint8_t flags;
+  flag_register& operator=(uint8_t bits) {
+    flags &= ~bits;
+    return *this;
+  }
+  operator uint8_t() const { return flags; }
+};
+
+// Timer1. TCNT1 is derived from the simulated time and can't be written.
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TIMSK1;
+extern flag_register TIFR1;
+extern volatile uint16_t OCR1A;
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define OCIE1A 1
+#define OCF1A 1
+uint16_t timer1_count();
+#define TCNT1 (timer1_count())
+
+// Timer3. It doesn't count, the host tools measure wall clock time instead.
+extern volatile uint8_t TCCR3A;
+extern volatile uint8_t TCCR3B;
+extern flag_register TIFR3;
+extern volatile uint16_t TCNT3;
+#define CS30 0
+#define TOV3 0
+
+#define ISR(vector) extern "C" void vector()
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Writes to stdout.
+class HardwareSerial {
+ public:
+  void begin(unsigned long) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  int availableForWrite() { return 64; }
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* buffer, size_t size);
+
+  void print(const char* value);
+  void print(char value);
+  void print(const __FlashStringHelper* value);
+  void print(int value, int base = DEC) { print((long)value, base); }
+  void print(unsigned int value, int base = DEC) { print((long)value, base); }
+  void print(long value, int base = DEC);
+  void print(unsigned long value, int base = DEC);
+  void print(double value);
+  void println();
+  void println(const char* value);
+  void println(const __FlashStringHelper* value);
+  void println(int value, int base = DEC) { println((long)value, base); }
+  void println(unsigned int value, int base = DEC) {
+    println((long)value, base);
+  }
+  void println(long value, int base = DEC);
+  void println(unsigned long value, int base = DEC);
+  void println(double value);
+};
+
+extern HardwareSerial Serial;
+
+#endif
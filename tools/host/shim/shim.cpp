@@ -0,0 +1,291 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <time.h>
+
+#include "Arduino.h"
+#include "HID.h"
+#include "shim.h"
+
+volatile uint8_t SREG = _BV(SREG_I);
+volatile uint8_t PIND = 0xFF;
+volatile uint8_t DDRD = 0;
+volatile uint8_t PORTD = 0;
+volatile uint8_t TCCR1A = 0;
+volatile uint8_t TCCR1B = 0;
+volatile uint8_t TIMSK1 = 0;
+flag_register TIFR1 = {0};
+volatile uint16_t OCR1A = 0;
+volatile uint8_t TCCR3A = 0;
+volatile uint8_t TCCR3B = 0;
+flag_register TIFR3 = {0};
+volatile uint16_t TCNT3 = 0;
+
+HardwareSerial Serial;
+
+// Only linked in when the firmware defines it.
+extern "C" void TIMER1_COMPA_vect() __attribute__((weak));
+
+namespace shim {
+unsigned long clock_read_cost_us = 1;
+void (*report_sent)(uint8_t id, const uint8_t* data, int length) = nullptr;
+FILE* serial_output = stdout;
+
+namespace {
+unsigned long now_us = 0;
+bool in_interrupt = false;
+
+bus_device* device_ = nullptr;
+uint8_t clock_mask_ = 0;
+uint8_t data_mask_ = 0;
+bool device_clock_low_ = false;
+bool device_data_low_ = false;
+
+const int interrupt_count = 8;
+void (*handlers[interrupt_count])();
+int modes[interrupt_count];
+uint8_t pending_interrupts = 0;
+unsigned long interrupt_calls_ = 0;
+unsigned long long interrupt_nanoseconds_ = 0;
+// Number of calls by wall clock time, in ns. The last bucket also counts the
+// slower ones, which are mostly the host preempting us.
+const int histogram_size = 1024;
+unsigned long interrupt_histogram_[histogram_size];
+
+unsigned long long wall_clock_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void call(void (*handler)()) {
+  unsigned long long start = wall_clock_ns();
+  handler();
+  unsigned long long elapsed = wall_clock_ns() - start;
+  interrupt_nanoseconds_ += elapsed;
+  interrupt_histogram_[elapsed < histogram_size ? elapsed
+                                                : histogram_size - 1]++;
+  interrupt_calls_++;
+}
+
+// A line is low if the MCU drives it low or the device pulls it low. When
+// the MCU doesn't drive a pin, the pull-up resistor keeps it high.
+bool line(uint8_t mask, bool device_low) {
+  bool mcu_low = (DDRD & mask) && !(PORTD & mask);
+  return !(mcu_low || device_low);
+}
+
+void update_pins() {
+  uint8_t previous = PIND;
+  uint8_t pins = 0xFF;
+  if (!line(clock_mask_, device_clock_low_)) pins &= ~clock_mask_;
+  if (!line(data_mask_, device_data_low_)) pins &= ~data_mask_;
+  PIND = pins;
+
+  for (int i = 0; i < interrupt_count; i++) {
+    uint8_t mask = _BV(i);
+    bool was_high = previous & mask;
+    bool is_high = pins & mask;
+    if (handlers[i] == nullptr || was_high == is_high) {
+      continue;
+    }
+    if (modes[i] == CHANGE || (modes[i] == FALLING && !is_high) ||
+        (modes[i] == RISING && is_high)) {
+      pending_interrupts |= mask;
+    }
+  }
+}
+
+void run_interrupts() {
+  if (in_interrupt || !(SREG & _BV(SREG_I))) {
+    return;
+  }
+
+  in_interrupt = true;
+  SREG &= ~_BV(SREG_I);
+  for (int i = 0; i < interrupt_count; i++) {
+    if (pending_interrupts & _BV(i)) {
+      pending_interrupts &= ~_BV(i);
+      call(handlers[i]);
+    }
+  }
+
+  if ((TIMSK1 & _BV(OCIE1A)) && (TIFR1 & _BV(OCF1A)) &&
+      TIMER1_COMPA_vect != nullptr) {
+    TIFR1 = _BV(OCF1A);
+    call(TIMER1_COMPA_vect);
+  }
+  SREG |= _BV(SREG_I);
+  in_interrupt = false;
+}
+
+// Timer1 counts at 250kHz when the prescaler is 64, which is the only
+// setting the firmware uses.
+uint16_t timer1_at(unsigned long us) { return (uint16_t)(us / 4); }
+}  // namespace
+
+void connect(bus_device* device, uint8_t clock_pin, uint8_t data_pin) {
+  device_ = device;
+  clock_mask_ = _BV(clock_pin);
+  data_mask_ = _BV(data_pin);
+  update_pins();
+  pending_interrupts = 0;
+}
+
+unsigned long now() { return now_us; }
+
+unsigned long interrupt_calls() { return interrupt_calls_; }
+
+unsigned long long interrupt_nanoseconds() { return interrupt_nanoseconds_; }
+
+unsigned long interrupt_percentile_nanoseconds(int percent) {
+  unsigned long calls = 0;
+  for (int ns = 0; ns < histogram_size; ns++) {
+    calls += interrupt_histogram_[ns];
+    if (calls * 100 >= (unsigned long long)interrupt_calls_ * percent) {
+      return ns;
+    }
+  }
+  return histogram_size - 1;
+}
+
+void advance(unsigned long us) {
+  for (unsigned long i = 0; i < us; i++) {
+    uint16_t before = timer1_at(now_us);
+    now_us++;
+    uint16_t after = timer1_at(now_us);
+    if (before != after && after == OCR1A) {
+      TIFR1.flags |= _BV(OCF1A);
+    }
+
+    if (device_ != nullptr) {
+      // Let the device see what the MCU has been doing in the meantime.
+      update_pins();
+      device_->tick(now_us, PIND & clock_mask_, PIND & data_mask_,
+                    &device_clock_low_, &device_data_low_);
+      update_pins();
+    }
+    run_interrupts();
+  }
+}
+}  // namespace shim
+
+void cli() { SREG &= ~_BV(SREG_I); }
+void sei() { SREG |= _BV(SREG_I); }
+
+uint16_t timer1_count() { return shim::timer1_at(shim::now_us); }
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+  shim::handlers[interrupt] = handler;
+  shim::modes[interrupt] = mode;
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  shim::handlers[interrupt] = nullptr;
+}
+
+unsigned long micros() {
+  if (!shim::in_interrupt) {
+    shim::advance(shim::clock_read_cost_us);
+  }
+  return shim::now_us;
+}
+
+unsigned long millis() {
+  if (!shim::in_interrupt) {
+    shim::advance(shim::clock_read_cost_us);
+  }
+  return shim::now_us / 1000;
+}
+
+void delay(unsigned long ms) { shim::advance(ms * 1000); }
+
+void delayMicroseconds(unsigned int us) { shim::advance(us); }
+
+HID_& HID() {
+  static HID_ instance;
+  return instance;
+}
+
+int HID_::SendReport(uint8_t id, const void* data, int length) {
+  if (shim::report_sent != nullptr) {
+    shim::report_sent(id, static_cast<const uint8_t*>(data), length);
+  }
+  return length;
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+  return fwrite(&data, 1, 1, shim::serial_output);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  return fwrite(buffer, 1, size, shim::serial_output);
+}
+
+void HardwareSerial::print(const char* value) {
+  fputs(value, shim::serial_output);
+}
+
+void HardwareSerial::print(char value) { fputc(value, shim::serial_output); }
+
+void HardwareSerial::print(const __FlashStringHelper* value) {
+  print(reinterpret_cast<const char*>(value));
+}
+
+void HardwareSerial::print(long value, int base) {
+  fprintf(shim::serial_output, base == HEX ? "%lX" : "%ld", value);
+}
+
+void HardwareSerial::print(unsigned long value, int base) {
+  fprintf(shim::serial_output, base == HEX ? "%lX" : "%lu", value);
+}
+
+void HardwareSerial::print(double value) {
+  fprintf(shim::serial_output, "%.2f", value);
+}
+
+void HardwareSerial::println() { fputc('\n', shim::serial_output); }
+
+void HardwareSerial::println(const char* value) {
+  print(value);
+  println();
+}
+
+void HardwareSerial::println(const __FlashStringHelper* value) {
+  print(value);
+  println();
+}
+
+void HardwareSerial::println(long value, int base) {
+  print(value, base);
+  println();
+}
+
+void HardwareSerial::println(unsigned long value, int base) {
+  print(value, base);
+  println();
+}
+
+void HardwareSerial::println(double value) {
+  print(value);
+  println();
+}
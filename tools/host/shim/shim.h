@@ -0,0 +1,70 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Host side control of the simulated MCU behind Arduino.h.
+
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace shim {
+
+// Something connected to the open collector clock and data lines of port D,
+// e.g. a simulated PS/2 device. A line is low if either side pulls it low.
+class bus_device {
+ public:
+  virtual ~bus_device() {}
+  // Called once per simulated microsecond with the state of the lines. Sets
+  // whether the device pulls them low.
+  virtual void tick(unsigned long now_us, bool clock, bool data,
+                    bool* pull_clock_low, bool* pull_data_low) = 0;
+};
+
+void connect(bus_device* device, uint8_t clock_pin, uint8_t data_pin);
+
+// Simulated time in microseconds since startup.
+unsigned long now();
+// Advances the simulated time, ticking the bus device and delivering pin
+// change and timer interrupts.
+void advance(unsigned long us);
+// Number of interrupt handler calls and the wall clock time spent in them.
+unsigned long interrupt_calls();
+unsigned long long interrupt_nanoseconds();
+// Wall clock time within which `percent` of the handler calls ran, up to
+// 1023ns. A high percentile stands for the slowest path through a handler,
+// where the maximum would be the host preempting us.
+unsigned long interrupt_percentile_nanoseconds(int percent);
+
+// Called for each report sent with HID().SendReport().
+extern void (*report_sent)(uint8_t id, const uint8_t* data, int length);
+
+// Where Serial writes to. stdout by default.
+extern FILE* serial_output;
+
+// How much time each call to millis() or micros() takes. Busy loops polling
+// them make progress this way.
+extern unsigned long clock_read_cost_us;
+}  // namespace shim
+
+#endif
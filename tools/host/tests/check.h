@@ -0,0 +1,72 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks for the host tests. A test is an executable that runs its checks,
+// prints the ones that fail and exits with 1 if there were any.
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+namespace test {
+inline int& failures() {
+  static int count = 0;
+  return count;
+}
+
+template <class A, class B>
+bool check_equal(const A& actual, const B& expected, const char* text,
+                 const char* file, int line) {
+  if ((long long)actual == (long long)expected) {
+    return true;
+  }
+  failures()++;
+  printf("%s:%d: %s is %lld, expected %lld\n", file, line, text,
+         (long long)actual, (long long)expected);
+  return false;
+}
+
+inline bool check(bool ok, const char* text, const char* file, int line) {
+  if (!ok) {
+    failures()++;
+    printf("%s:%d: %s failed\n", file, line, text);
+  }
+  return ok;
+}
+
+// Return from main().
+inline int result() {
+  if (failures() == 0) {
+    return 0;
+  }
+  printf("%d checks failed\n", failures());
+  return 1;
+}
+}  // namespace test
+
+#define CHECK(condition) \
+  test::check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) \
+  test::check_equal((actual), (expected), #actual, __FILE__, __LINE__)
+
+#endif
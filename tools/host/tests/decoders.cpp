@@ -0,0 +1,119 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// The byte decoders of src/synaptics.h against the 64-bit extraction they
+// replaced, which read the packet as one little-endian integer. Bit for bit,
+// on every single bit packet and on random ones.
+
+#include <string.h>
+
+#include "../../../src/synaptics.h"
+#include "check.h"
+
+namespace {
+const long random_count = 20000000;
+
+// The previous decoding, from parse_primary_packet() and
+// parse_extended_packet().
+struct reference {
+  int x, y, z, w;
+  bool button;
+  int packet_code;
+  int secondary_x, secondary_y, secondary_z;
+
+  explicit reference(const synaptics::packet& p) {
+    // Byte i goes to bits [8i, 8i + 7].
+    uint64_t packet = 0;
+    for (int i = 0; i < synaptics::packet_size; i++) {
+      packet |= (uint64_t)p.bytes[i] << (8 * i);
+    }
+    x = (packet >> 32) & 0x00FF | (packet >> 0) & 0x0F00 |
+        (packet >> 16) & 0x1000;
+    y = (packet >> 40) & 0x00FF | (packet >> 4) & 0x0F00 |
+        (packet >> 17) & 0x1000;
+    z = (packet >> 16) & 0xFF;
+    w = (packet >> 26) & 0x01 | (packet >> 1) & 0x2 | (packet >> 2) & 0x0C;
+    button = (packet >> 24) & 0x01;
+    packet_code = (packet >> 44) & 0x0F;
+    secondary_x = (packet >> 7) & 0x01FE | (packet >> 23) & 0x1E00;
+    secondary_y = (packet >> 15) & 0x01FE | (packet >> 27) & 0x1E00;
+    secondary_z = (packet >> 39) & 0x1D | (packet >> 23) & 0x60;
+  }
+};
+
+// Returns false at the first difference, so a broken decoder doesn't print
+// millions of lines.
+bool compare(const synaptics::packet& p) {
+  reference expected(p);
+  synaptics::contact primary = synaptics::decode_primary(p);
+  synaptics::contact secondary = synaptics::decode_secondary(p);
+  bool ok = CHECK_EQUAL(primary.x, expected.x) &&
+            CHECK_EQUAL(primary.y, expected.y) &&
+            CHECK_EQUAL(primary.z, expected.z) &&
+            CHECK_EQUAL(primary.w, expected.w) &&
+            CHECK_EQUAL(synaptics::decode_w(p), expected.w) &&
+            CHECK_EQUAL(primary.button, expected.button) &&
+            CHECK_EQUAL(synaptics::extended_packet_code(p),
+                        expected.packet_code) &&
+            CHECK_EQUAL(secondary.x, expected.secondary_x) &&
+            CHECK_EQUAL(secondary.y, expected.secondary_y) &&
+            CHECK_EQUAL(secondary.z, expected.secondary_z);
+  if (!ok) {
+    printf("  packet %02X %02X %02X %02X %02X %02X\n", p.bytes[0], p.bytes[1],
+           p.bytes[2], p.bytes[3], p.bytes[4], p.bytes[5]);
+  }
+  return ok;
+}
+
+uint32_t random_state = 1;
+uint32_t next_random() {
+  // xorshift32, so that the packets are the same on every host.
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+}  // namespace
+
+int main() {
+  synaptics::packet p = {};
+  // Each bit on its own, then all of them.
+  for (int bit = 0; bit < 8 * synaptics::packet_size; bit++) {
+    memset(p.bytes, 0, sizeof(p.bytes));
+    p.bytes[bit / 8] = 1 << (bit % 8);
+    if (!compare(p)) {
+      return test::result();
+    }
+  }
+  memset(p.bytes, 0xFF, sizeof(p.bytes));
+  compare(p);
+
+  for (long n = 0; n < random_count && test::failures() == 0; n++) {
+    uint32_t low = next_random();
+    uint32_t high = next_random();
+    memcpy(p.bytes, &low, 4);
+    p.bytes[4] = high;
+    p.bytes[5] = high >> 8;
+    compare(p);
+  }
+  return test::result();
+}
@@ -0,0 +1,138 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// The fixed-point helpers of touchpad.ino against their definitions in floats.
+
+#include <math.h>
+#include <string.h>
+
+#include "../../../touchpad.ino"
+#include "check.h"
+
+namespace {
+void test_conversions() {
+  CHECK_EQUAL(q8(1), 256);
+  CHECK_EQUAL(q8(0.2F), 51);
+  CHECK_EQUAL(q16(1), 65536);
+  CHECK_EQUAL(q16(0.08F), 5243);
+  // Toward zero, like a float to int conversion.
+  CHECK_EQUAL(q8_to_int(255), 0);
+  CHECK_EQUAL(q8_to_int(256), 1);
+  CHECK_EQUAL(q8_to_int(q8(127)), 127);
+  CHECK_EQUAL(q8_to_int(-255), 0);
+  CHECK_EQUAL(q8_to_int(-300), -1);
+}
+
+// Each parameter is within rounding of its value in floats.
+void test_device_params(int units_x, int units_y) {
+  device_params params = make_device_params(units_x, units_y);
+  CHECK(fabs(params.scale_tracking_x - scale_tracking_mm / units_x * 65536) <=
+        0.5);
+  CHECK(fabs(params.scale_tracking_y - scale_tracking_mm / units_y * 65536) <=
+        0.5);
+  CHECK(fabs(params.scale_scroll - scale_scroll_mm / units_y * 65536) <= 0.5);
+  CHECK(fabs(params.mm_per_unit_x - 65536.0 / units_x) <= 0.5);
+  CHECK(fabs(params.mm_per_unit_y - 65536.0 / units_y) <= 0.5);
+  CHECK(fabs(params.noise_threshold_tracking_x -
+             noise_threshold_tracking_mm * units_x * 256) <= 1);
+  CHECK(fabs(params.noise_threshold_scrolling_y -
+             noise_threshold_scrolling_mm * units_y * 256) <= 1);
+  CHECK(abs(params.max_delta_x - (int)(max_delta_mm * units_x)) <= 1);
+  CHECK(abs(params.slow_scroll_threshold -
+            (int)(slow_scroll_threshold_mm * units_y)) <= 1);
+  CHECK_EQUAL(params.proximity_threshold_y, proximity_threshold_mm * units_y);
+}
+
+void test_known_device() {
+  // Computed at compile time into flash, the same as at run time.
+  device_params params = make_device_params(47, 66);
+  CHECK(memcmp(&params, &known_device<0x0887>::params, sizeof(params)) == 0);
+
+  synaptics::model = 0x0887;
+  synaptics::units_per_mm_x = 47;
+  synaptics::units_per_mm_y = 66;
+  memset(&params, 0, sizeof(params));
+  CHECK(load_known_device<0x0887>(&params));
+  CHECK(memcmp(&params, &known_device<0x0887>::params, sizeof(params)) == 0);
+  // The parameters only apply at the resolution they were made for.
+  synaptics::units_per_mm_y = 33;
+  CHECK(!load_known_device<0x0887>(&params));
+}
+
+void test_magnitude() {
+  for (int x = 0; x < 2048; x += 7) {
+    for (int y = 0; y < 2048; y += 5) {
+      double length = sqrt((double)x * x + (double)y * y);
+      uint16_t m = magnitude(x, y);
+      // -3% to +1%, and the rounding of the integer divisions.
+      if (!CHECK(m >= length * 0.97 - 1 && m <= length * 1.01 + 1)) {
+        printf("  magnitude(%d, %d) = %u\n", x, y, m);
+        return;
+      }
+    }
+  }
+}
+
+void test_to_hid_value() {
+  const int32_t threshold = q8(4);
+  const int32_t scale = q16(0.25F);
+  CHECK_EQUAL(to_hid_value(0, threshold, scale), 0);
+  CHECK_EQUAL(to_hid_value(3, threshold, scale), 0);
+  CHECK_EQUAL(to_hid_value(-3, threshold, scale), 0);
+  // At least one unit once past the threshold.
+  CHECK_EQUAL(to_hid_value(4, threshold, scale), q8(1));
+  CHECK_EQUAL(to_hid_value(-4, threshold, scale), -q8(1));
+  CHECK_EQUAL(to_hid_value(10, threshold, scale), q8(2.5F));
+  CHECK_EQUAL(to_hid_value(-10, threshold, scale), -q8(2.5F));
+  CHECK_EQUAL(to_hid_value(1000, threshold, scale), q8(127));
+  // Clamped before the product could overflow.
+  CHECK_EQUAL(to_hid_value(30000, threshold, q16(100)), q8(127));
+  CHECK_EQUAL(to_hid_value(-30000, threshold, q16(100)), -q8(127));
+}
+
+void test_acceleration() {
+  typedef acceleration::linear<q8(acceleration_per_mm)> curve;
+  const uint16_t step = q8(0.25F);
+  const uint16_t last = 31 * step;
+  for (uint16_t speed = 0; speed <= last; speed++) {
+    // The curve is linear, so the interpolation is exact up to rounding.
+    if (!CHECK(abs(acceleration_curve::at(speed) - curve::at(speed)) <= 1)) {
+      printf("  speed %u\n", speed);
+      return;
+    }
+  }
+  CHECK_EQUAL(acceleration_curve::at(last + 1), curve::at(last));
+  CHECK_EQUAL(acceleration_curve::at(65535), curve::at(last));
+}
+}  // namespace
+
+int main() {
+  test_conversions();
+  test_device_params(47, 66);
+  test_device_params(85, 94);
+  test_device_params(12, 13);
+  test_known_device();
+  test_magnitude();
+  test_to_hid_value();
+  test_acceleration();
+  return test::result();
+}
@@ -0,0 +1,207 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// The fixed-point motion pipeline of touchpad.ino against the float version
+// it replaced, on every movement up to max_delta_mm, with a range of
+// pressures, widths and finger counts, at several resolutions.
+//
+// Tolerances:
+// - Tracking: 1 HID unit, plus 1% of the value for the rounding of the Q8 and
+//   Q16 constants. The float version computes the speed with sqrt(), which
+//   magnitude() approximates from -3% to +1%. Tracking is compared twice:
+//   against the float version as it was, with 3% more tolerance, and with
+//   the same approximation of the speed in floats. A movement within 1% of
+//   the noise threshold may also be cut by one version and not the other.
+// - Scrolling: 2/256 detent.
+
+#include <math.h>
+
+#include "../../../touchpad.ino"
+#include "check.h"
+
+namespace {
+// The float version, as parse_primary_packet() and setup() computed it.
+struct float_pipeline {
+  // sqrt() for the speed, or the approximation of magnitude().
+  bool exact_speed;
+  float units_x, units_y;
+  float scale_tracking_x, scale_tracking_y, scale_scroll;
+  float noise_threshold_tracking_x, noise_threshold_tracking_y;
+  float noise_threshold_scrolling_y;
+  float slow_scroll_threshold;
+
+  float_pipeline(int units_per_mm_x, int units_per_mm_y, bool exact_speed)
+      : exact_speed(exact_speed),
+        units_x(units_per_mm_x),
+        units_y(units_per_mm_y),
+        scale_tracking_x(scale_tracking_mm / units_x),
+        scale_tracking_y(scale_tracking_mm / units_y),
+        scale_scroll(scale_scroll_mm / units_y),
+        noise_threshold_tracking_x(noise_threshold_tracking_mm * units_x),
+        noise_threshold_tracking_y(noise_threshold_tracking_mm * units_y),
+        noise_threshold_scrolling_y(noise_threshold_scrolling_mm * units_y),
+        slow_scroll_threshold(slow_scroll_threshold_mm * units_y) {}
+
+  static float to_hid_value(float value, float threshold, float scale_factor) {
+    const float hid_max = 127.0F;
+    if (fabsf(value) < threshold) {
+      return 0;
+    }
+    return sign(value) * fminf(fmaxf(fabsf(value) * scale_factor, 1.0F),
+                               hid_max);
+  }
+
+  float scroll(int delta_y) const {
+    float amount =
+        to_hid_value(delta_y, noise_threshold_scrolling_y, scale_scroll);
+    if (abs(delta_y) <= slow_scroll_threshold) {
+      amount = sign(amount) * slow_scroll_amount;
+    }
+    return amount;
+  }
+
+  // Before the conversion to int8_t. `threshold_x` and `threshold_y` are set
+  // to the noise thresholds used.
+  void track(int delta_x, int delta_y, short z, short width, int fingers,
+             float* hid_x, float* hid_y, float* threshold_x,
+             float* threshold_y) const {
+    float threshold_multiplier = fingers == 1 ? 1.0 : 2.0;
+    if (width > 4) {
+      threshold_multiplier *= 1.0F + (width - 4.0F) / 4.0F;
+    }
+    if (z >= 60) {
+      threshold_multiplier *= 1.0F + (z - 60.0F) / 40.0F;
+    }
+    float delta_x_mm = delta_x / units_x;
+    float delta_y_mm = delta_y / units_y;
+    float velocity = sqrtf(delta_x_mm * delta_x_mm + delta_y_mm * delta_y_mm);
+    if (!exact_speed) {
+      float high = fmaxf(fabsf(delta_x_mm), fabsf(delta_y_mm));
+      float low = fminf(fabsf(delta_x_mm), fabsf(delta_y_mm));
+      velocity = fmaxf(high, high * 7 / 8 + low / 2);
+    }
+    if (fingers > 1) {
+      velocity *= 2;
+    }
+    float scale_multiplier = 1.0F + velocity * acceleration_per_mm;
+    *threshold_x = noise_threshold_tracking_x * threshold_multiplier;
+    *threshold_y = noise_threshold_tracking_y * threshold_multiplier;
+    *hid_x = to_hid_value(delta_x, *threshold_x,
+                          scale_tracking_x * scale_multiplier);
+    *hid_y = -to_hid_value(delta_y, *threshold_y,
+                           scale_tracking_y * scale_multiplier);
+  }
+};
+
+long compared = 0;
+long off_by_one = 0;
+long off_by_more = 0;
+
+bool close_enough(int8_t fixed, float reference, int delta, float threshold,
+                  float relative_tolerance) {
+  compared++;
+  int8_t expected = reference;
+  if (fixed == expected) {
+    return true;
+  }
+  if (abs(fixed - expected) == 1) {
+    off_by_one++;
+  } else {
+    off_by_more++;
+  }
+  if (fabsf(abs(delta) - threshold) <= threshold * 0.01F) {
+    return true;
+  }
+  return fixed != 0 && expected != 0 &&
+         fabsf(fixed - reference) <= 1 + fabsf(reference) * relative_tolerance;
+}
+
+void test_tracking(int units_x, int units_y, bool exact_speed) {
+  float_pipeline reference(units_x, units_y, exact_speed);
+  float relative_tolerance = exact_speed ? 0.04F : 0.01F;
+  device = make_device_params(units_x, units_y);
+  // Deltas past max_delta_mm reset the finger instead of being reported.
+  int max_x = device.max_delta_x;
+  int max_y = device.max_delta_y;
+  const short zs[] = {30, 59, 60, 61, 80, 120, 255};
+  const short widths[] = {4, 5, 8, 15};
+  for (int fingers = 1; fingers <= 3; fingers++) {
+    for (short z : zs) {
+      for (short width : widths) {
+        for (int delta_x = -max_x; delta_x <= max_x; delta_x++) {
+          for (int delta_y = -max_y; delta_y <= max_y; delta_y++) {
+            int8_t hid_x, hid_y;
+            tracking_hid_values(delta_x, delta_y, z, width, fingers, &hid_x,
+                                &hid_y);
+            float expected_x, expected_y, threshold_x, threshold_y;
+            reference.track(delta_x, delta_y, z, width, fingers, &expected_x,
+                            &expected_y, &threshold_x, &threshold_y);
+            if (!CHECK(close_enough(hid_x, expected_x, delta_x, threshold_x,
+                                    relative_tolerance)) ||
+                !CHECK(close_enough(hid_y, expected_y, delta_y, threshold_y,
+                                    relative_tolerance))) {
+              printf("  %dx%d units/mm, delta (%d, %d), z %d, width %d, "
+                     "%d fingers: (%d, %d), expected (%.2f, %.2f)\n",
+                     units_x, units_y, delta_x, delta_y, z, width, fingers,
+                     hid_x, hid_y, expected_x, expected_y);
+              return;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void test_scrolling(int units_x, int units_y) {
+  float_pipeline reference(units_x, units_y, true);
+  device = make_device_params(units_x, units_y);
+  for (int delta_y = -device.max_delta_y; delta_y <= device.max_delta_y;
+       delta_y++) {
+    float expected = reference.scroll(delta_y) * 256;
+    int16_t scroll = scroll_hid_value(delta_y);
+    if (!CHECK(fabsf(scroll - expected) <= 2)) {
+      printf("  %dx%d units/mm, delta %d: %d/256, expected %.2f/256\n",
+             units_x, units_y, delta_y, scroll, expected);
+      return;
+    }
+  }
+}
+}  // namespace
+
+int main() {
+  // The T1320A, the resolution of many Synaptics touchpads, and a coarse one.
+  const int resolutions[][2] = {{47, 66}, {85, 94}, {20, 25}};
+  for (int exact_speed = 1; exact_speed >= 0; exact_speed--) {
+    compared = off_by_one = off_by_more = 0;
+    for (const int* units : resolutions) {
+      test_tracking(units[0], units[1], exact_speed);
+    }
+    printf("%s: %ld tracking values, %ld off by one, %ld by more\n",
+           exact_speed ? "sqrt" : "approximated speed", compared, off_by_one,
+           off_by_more);
+  }
+  for (const int* units : resolutions) {
+    test_scrolling(units[0], units[1]);
+  }
+  return test::result();
+}
@@ -0,0 +1,104 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Framing of PS/2 bytes into packets by byte_received() of touchpad.ino:
+// resync on the fixed bits, bytes with errors and a full queue.
+
+#include <string.h>
+
+#include "../../../touchpad.ino"
+#include "check.h"
+
+namespace {
+const uint8_t packet_bytes[synaptics::packet_size] = {0x80, 0xb9, 0x46,
+                                                      0xc0, 0xc4, 0xb8};
+
+void send_packet(uint16_t time) {
+  for (uint8_t i = 0; i < synaptics::packet_size; i++) {
+    byte_received(packet_bytes[i], time, false);
+  }
+}
+
+void check_packet(uint16_t time) {
+  if (!CHECK(!packets.empty())) {
+    return;
+  }
+  CHECK(memcmp(packets.front().bytes, packet_bytes, sizeof(packet_bytes)) ==
+        0);
+  CHECK_EQUAL(packets.front().time, time);
+  packets.pop_front();
+}
+
+void test_packet() {
+  send_packet(1);
+  check_packet(1);
+  CHECK(packets.empty());
+}
+
+void test_resync() {
+  uint16_t byte0_errors = errors::count(errors::unexpected_byte0);
+  // The tail of a packet whose start was missed.
+  byte_received(0x46, 2, false);
+  byte_received(0xc0, 2, false);
+  send_packet(2);
+  check_packet(2);
+  CHECK(packets.empty());
+  CHECK_EQUAL(errors::count(errors::unexpected_byte0), byte0_errors + 2);
+}
+
+void test_error_byte() {
+  byte_received(0x80, 3, false);
+  byte_received(0xb9, 3, false);
+  byte_received(0x00, 3, true);
+  send_packet(3);
+  check_packet(3);
+  CHECK(packets.empty());
+}
+
+// A byte with an error in a dropped packet doesn't cost the next packet,
+// once the queue has room again.
+void test_error_while_full() {
+  uint16_t overflows = errors::count(errors::packet_overflow);
+  while (errors::count(errors::packet_overflow) == overflows) {
+    send_packet(4);
+  }
+  uint8_t queued = packets.size();
+  byte_received(0x80, 4, false);
+  byte_received(0x00, 4, true);
+  packets.pop_front();
+  send_packet(5);
+  CHECK_EQUAL(errors::count(errors::packet_overflow), overflows + 1);
+  CHECK_EQUAL(packets.size(), queued);
+  for (uint8_t i = 1; i < queued; i++) {
+    check_packet(4);
+  }
+  check_packet(5);
+}
+}  // namespace
+
+int main() {
+  test_packet();
+  test_resync();
+  test_error_byte();
+  test_error_while_full();
+  return test::result();
+}
@@ -0,0 +1,94 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// SpscQueue on a single thread: order, wrap around of the 8-bit indices and
+// overflow counting.
+
+#include "../../../src/queue.h"
+#include "check.h"
+
+namespace {
+void test_order() {
+  SpscQueue<int, 4> queue;
+  CHECK(queue.empty());
+  // Enough items to wrap the indices around a few times.
+  int next_pushed = 0;
+  int next_popped = 0;
+  for (int round = 0; round < 300; round++) {
+    int count = round % 5;
+    for (int i = 0; i < count; i++) {
+      if (queue.push_back(next_pushed)) {
+        next_pushed++;
+      }
+    }
+    CHECK(queue.size() <= 4);
+    while (!queue.empty()) {
+      CHECK_EQUAL(queue.front(), next_popped);
+      queue.pop_front();
+      next_popped++;
+    }
+  }
+  CHECK_EQUAL(next_popped, next_pushed);
+}
+
+void test_overflow() {
+  SpscQueue<int, 2> queue;
+  CHECK(queue.push_back(1));
+  CHECK(queue.push_back(2));
+  CHECK(!queue.push_back(3));
+  CHECK(queue.reserve() == nullptr);
+  CHECK_EQUAL(queue.overflows(), 2);
+  CHECK_EQUAL(queue.size(), 2);
+  queue.pop_front();
+  CHECK(queue.push_back(4));
+  CHECK_EQUAL(queue.front(), 2);
+  queue.pop_front();
+  CHECK_EQUAL(queue.front(), 4);
+  queue.pop_front();
+  CHECK(queue.empty());
+  // Popping an empty queue does nothing.
+  queue.pop_front();
+  CHECK(queue.empty());
+  CHECK_EQUAL(queue.overflows(), 2);
+}
+
+void test_reserve() {
+  SpscQueue<int, 4> queue;
+  int* slot = queue.reserve();
+  CHECK(slot != nullptr);
+  // Nothing is visible until commit(), and the slot stays the same.
+  CHECK(queue.empty());
+  CHECK(queue.reserve() == slot);
+  *slot = 7;
+  queue.commit();
+  CHECK_EQUAL(queue.size(), 1);
+  CHECK_EQUAL(queue.front(), 7);
+  CHECK(queue.reserve() != slot);
+}
+}  // namespace
+
+int main() {
+  test_order();
+  test_overflow();
+  test_reserve();
+  return test::result();
+}
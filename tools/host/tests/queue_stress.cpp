@@ -0,0 +1,126 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2024 Deling Ren
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// SpscQueue with the producer and the consumer on two threads, hammering it
+// as fast as they can. Every item must come out once, in order and whole.
+// Either side yields when it can't make progress, so that the test also
+// finishes in reasonable time on a single core.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+
+// A compiler barrier is enough on the single core ATmega32U4, where the
+// producer is an interrupt handler. Threads may run on cores that reorder
+// memory accesses, which a fence prevents.
+#define QUEUE_BARRIER() std::atomic_thread_fence(std::memory_order_seq_cst)
+
+#include "../../../src/queue.h"
+#include "check.h"
+
+namespace {
+const uint32_t item_count = 1000000;
+
+// Larger than a word, so that a torn item shows up as a bad checksum.
+struct item {
+  uint32_t sequence;
+  uint8_t bytes[6];
+  uint32_t check;
+};
+
+uint32_t checksum(const item& i) {
+  uint32_t sum = i.sequence * 2654435761u;
+  for (uint8_t b : i.bytes) {
+    sum = sum * 31 + b;
+  }
+  return sum;
+}
+
+template <uint8_t N>
+void stress() {
+  SpscQueue<item, N> queue;
+  uint32_t full = 0;
+
+  std::thread producer([&queue, &full] {
+    for (uint32_t sequence = 0; sequence < item_count;) {
+      // Alternate between the two ways to produce.
+      item* slot = nullptr;
+      item local;
+      bool in_place = sequence & 1;
+      if (in_place) {
+        slot = queue.reserve();
+        if (slot == nullptr) {
+          full++;
+          std::this_thread::yield();
+          continue;
+        }
+      } else {
+        slot = &local;
+      }
+      slot->sequence = sequence;
+      for (int i = 0; i < 6; i++) {
+        slot->bytes[i] = sequence >> i;
+      }
+      slot->check = checksum(*slot);
+      if (in_place) {
+        queue.commit();
+      } else if (!queue.push_back(local)) {
+        full++;
+        std::this_thread::yield();
+        continue;
+      }
+      sequence++;
+    }
+  });
+
+  uint32_t expected = 0;
+  uint32_t bad = 0;
+  while (expected < item_count) {
+    if (queue.empty()) {
+      std::this_thread::yield();
+      continue;
+    }
+    const item& front = queue.front();
+    if (front.sequence != expected || front.check != checksum(front)) {
+      bad++;
+    }
+    expected = front.sequence + 1;
+    queue.pop_front();
+  }
+  producer.join();
+
+  printf("N = %u: %u items, queue full %u times\n", N, item_count, full);
+  CHECK_EQUAL(bad, 0);
+  CHECK(queue.empty());
+  // The counter is 16-bit and wraps around.
+  CHECK_EQUAL(queue.overflows(), (uint16_t)full);
+}
+}  // namespace
+
+int main() {
+  stress<2>();
+  stress<4>();
+  stress<128>();
+  return test::result();
+}
@@ -20,8 +20,14 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "src/acceleration.h"
+#include "src/capture.h"
+#include "src/errors.h"
+#include "src/filters.h"
 #include "src/hid.h"
+#include "src/profile.h"
 #include "src/ps2.h"
+#include "src/queue.h"
 #include "src/synaptics.h"
 
 #ifndef min
@@ -41,54 +47,145 @@
 // fine turning them.
 
 // When finger is held *still*, the maximum flucation from frame to frame in mm.
-const float noise_threshold_tracking_mm = 0.08;
-const float noise_threshold_scrolling_mm = 0.09;
+constexpr float noise_threshold_tracking_mm = 0.08;
+constexpr float noise_threshold_scrolling_mm = 0.09;
 
 // In order to retrospectively change the frames in the past, we delay reporting
 // for a few frames. This needs to be short enough that it's not perceptible.
 const int frames_delay = 6;
+// The position filter predicts this many frames ahead, to make up for part of
+// that delay. Each frame more cuts the lag but overshoots when the finger
+// stops.
+const int frames_predicted = 1;
+static_assert(frames_predicted <= frames_delay, "Predicts past the delay");
 // After the button is released, we freeze for a few frames since the finger is
 // likely going to be very unstable. Since it's very hard to release the button
 // and start moving immediately, it's OK to keep this frozen period relatively
 // long.
 const int frames_stablization = 15;
+// Resets and initializations of the touchpad tried in setup().
+const int init_attempts = 3;
 
 // HID units per mm, when tracking.
-const float scale_tracking_mm = 12.0;
+constexpr float scale_tracking_mm = 12.0;
 // HID units per mm, when scrolling.
-const float scale_scroll_mm = 1.6;
+constexpr float scale_scroll_mm = 1.6;
+// Tracking gets faster with speed. Increase of scale_tracking_mm per mm/frame.
+// Emperical constant
+constexpr float acceleration_per_mm = 0.5F;
 // Cutoff speed between slow and fast scrolling, in mm/frame.
-const float slow_scroll_threshold_mm = 2.0;
+constexpr float slow_scroll_threshold_mm = 2.0;
 // Max distance between two frames.
-const float max_delta_mm = 3;
+constexpr float max_delta_mm = 3;
 // The delta in either direction within which is considered normal movements
 // between frames while scrolling at a moderate speed.
-const int proximity_threshold_mm = 15;
+constexpr int proximity_threshold_mm = 15;
 // The amount of scroll per detent, in HID units
-const float slow_scroll_amount = 0.20F;
-
-// HID units per raw unit, when tracking.
-float scale_tracking_x, scale_tracking_y;
-// UID units per raw unit, when scrolling.
-float scale_scroll;
-// Max fluctuation from frame to frame in raw units.
-float noise_threshold_tracking_x, noise_threshold_tracking_y;
-
-float noise_threshold_scrolling_y;
-
-// Max distance from frame to frame in raw units.
-float max_delta_x, max_delta_y;
-// Cutoff speed between slow and fast scrolling, in raw units per frame.
-float slow_scroll_threshold;
-// The delta within which is considered normal movements between frames while
-// scrolling at a moderate speed.
-float proximity_threshold_x, proximity_threshold_y;
-
-struct finger_state {
-  SimpleAverage<int, 5> x;
-  SimpleAverage<int, 5> y;
+constexpr float slow_scroll_amount = 0.20F;
+// HID units per unit reported by a guest device, e.g. a pointing stick behind
+// the touchpad.
+constexpr float scale_guest = 1.0F;
+// Measure the cycles spent on each packet and print them to the serial port.
+// See src/profile.h.
+const bool profiling = false;
+
+// Everything derived from the consts above and the resolution of the
+// touchpad.
+struct device_params {
+  // HID units per raw unit, when tracking. Q16.
+  int32_t scale_tracking_x, scale_tracking_y;
+  // UID units per raw unit, when scrolling. Q16.
+  int32_t scale_scroll;
+  // mm per raw unit. Q16.
+  int32_t mm_per_unit_x, mm_per_unit_y;
+  // Max fluctuation from frame to frame in raw units. Q8.
+  int32_t noise_threshold_tracking_x, noise_threshold_tracking_y;
+
+  int32_t noise_threshold_scrolling_y;
+
+  // Max distance from frame to frame in raw units.
+  int max_delta_x, max_delta_y;
+  // Cutoff speed between slow and fast scrolling, in raw units per frame.
+  int slow_scroll_threshold;
+  // The delta within which is considered normal movements between frames
+  // while scrolling at a moderate speed.
+  int proximity_threshold_x, proximity_threshold_y;
+};
+
+// There is no FPU. Everything derived from the consts above is fixed-point,
+// with 8 (Q8) or 16 (Q16) fractional bits. Only positive values are converted.
+constexpr int32_t q8(float value) { return value * 256 + 0.5F; }
+constexpr int32_t q16(float value) { return value * 65536 + 0.5F; }
+
+// Truncates a Q8 value toward zero, like converting a float to an int.
+int8_t q8_to_int(int16_t value) { return value / 256; }
+
+// Integer math only, so that it runs at compile time for the touchpads in
+// synaptics::known_model, and at run time for others. Divisions are rounded.
+constexpr device_params make_device_params(int32_t units_x, int32_t units_y) {
+  return device_params{
+      (q16(scale_tracking_mm) + units_x / 2) / units_x,
+      (q16(scale_tracking_mm) + units_y / 2) / units_y,
+      (q16(scale_scroll_mm) + units_y / 2) / units_y,
+      (q16(1) + units_x / 2) / units_x,
+      (q16(1) + units_y / 2) / units_y,
+      q16(noise_threshold_tracking_mm) * units_x >> 8,
+      q16(noise_threshold_tracking_mm) * units_y >> 8,
+      q16(noise_threshold_scrolling_mm) * units_y >> 8,
+      (int)(q8(max_delta_mm) * units_x >> 8),
+      (int)(q8(max_delta_mm) * units_y >> 8),
+      (int)(q8(slow_scroll_threshold_mm) * units_y >> 8),
+      (int)(proximity_threshold_mm * units_x),
+      (int)(proximity_threshold_mm * units_y)};
+}
+
+// The parameters of a touchpad in synaptics::known_model, computed at compile
+// time and kept in flash.
+template <uint16_t Model>
+struct known_device {
+  static const device_params params PROGMEM;
+};
+template <uint16_t Model>
+const device_params known_device<Model>::params PROGMEM = make_device_params(
+    synaptics::known_model<Model>::units_per_mm_x,
+    synaptics::known_model<Model>::units_per_mm_y);
+
+// Loads the parameters of Model, if that's the touchpad connected. They
+// only apply if the touchpad also reports the resolution they expect.
+template <uint16_t Model>
+bool load_known_device(device_params* params) {
+  typedef synaptics::known_model<Model> known;
+  if (synaptics::model != Model ||
+      synaptics::units_per_mm_x != known::units_per_mm_x ||
+      synaptics::units_per_mm_y != known::units_per_mm_y) {
+    return false;
+  }
+  memcpy_P(params, &known_device<Model>::params, sizeof(device_params));
+  return true;
+}
+
+device_params device;
+
+// Multiplier of the tracking scale by speed, sampled every 1/4 mm/frame up to
+// 8 mm/frame, where a report saturates anyway. Any curve in
+// src/acceleration.h fits, e.g. two_slopes<q8(0.25F), q8(1), q8(2)>.
+typedef acceleration::table<acceleration::linear<q8(acceleration_per_mm)>, 32,
+                            q8(0.25F)>
+    acceleration_curve;
+
+// Smoothing of finger positions. Any filter in src/filters.h fits, e.g.
+// PowerOfTwoAverage<int, 4>, MedianOf3<int, PowerOfTwoAverage<int, 4> > or
+// OneEuroFilter<int, 26, 8>. Compare them with replay -m. Alpha and Beta are
+// critically damped.
+typedef AlphaBetaTracker<int, 128, 43, frames_predicted> position_filter;
+
+template <class Filter>
+struct basic_finger_state {
+  Filter x;
+  Filter y;
   short z;
 };
+typedef basic_finger_state<position_filter> finger_state;
 
 struct report {
   uint8_t buttons;
@@ -99,7 +196,9 @@ struct report {
 
 // In reality we don't really need a ring buffer for packets. A 16MHz ATMega32U4
 // can easily handle 80 frames per second without skipping frames.
-RingBuffer<uint64_t, 4> packets;
+// Packets are framed in place by the PS/2 interrupt handler and consumed in
+// place by loop(), so no copying or 64-bit arithmetic happens in the ISR.
+SpscQueue<synaptics::packet, 4> packets;
 RingBuffer<report, 32> reports;
 
 static unsigned long global_tick = 0;
@@ -112,44 +211,112 @@ static finger_state finger_states[2];
 static short finger_count = 0;
 static uint8_t button_state = 0;  // bit 0: L, bit 1: R
 
+// Buttons of the guest device, and of the last report of the touchpad that was
+// sent. Each is merged into the reports of the other.
+static uint8_t guest_buttons = 0;
+static uint8_t touchpad_buttons = 0;
+
 const uint8_t LEFT_BUTTON = 0x01;
 const uint8_t RIGHT_BUTTON = 0x02;
 
-void byte_received(uint8_t data) {
-  static uint64_t buffer = 0;
-  static int index = 0;
-
-  if (index == 0 && (data & 0xc8) != 0x80) {
-    Serial.print("Unexpected byte0 data ");
-    Serial.println(data, HEX);
-
+// The Arduino IDE generates prototypes for the functions in a sketch. Other
+// compilers, e.g. for the host tools, need them spelled out.
+void parse_primary_packet(const synaptics::contact& contact);
+void parse_extended_packet(const synaptics::packet& packet);
+void parse_guest_packet(const synaptics::packet& packet);
+
+// Fixed bits of bytes 0 and 3 of an absolute mode packet.
+// Reference: Section 3.2.1, Figure 3-4
+inline bool plausible_byte0(uint8_t data) { return (data & 0xc8) == 0x80; }
+inline bool plausible_byte3(uint8_t data) { return (data & 0xc8) == 0xc0; }
+
+void byte_received(uint8_t data, uint16_t time, bool error) {
+  // Used when the queue is full. The packet is dropped but we still need to
+  // frame it to stay in sync.
+  static synaptics::packet overflow;
+  // Reserved once per packet, and kept while the window below slides.
+  static synaptics::packet* slot = nullptr;
+  static uint8_t index = 0;
+
+  // This runs in interrupt context. Errors are only recorded here and printed
+  // later from loop().
+  if (error) {
+    // Any byte of this packet could be wrong. Drop it all. A reserved slot
+    // is kept for the next packet, but the queue may have room again.
     index = 0;
-    buffer = 0;
+    if (slot == &overflow) {
+      slot = nullptr;
+    }
     return;
   }
 
-  if (index == 24 && (data & 0xc8) != 0xc0) {
-    Serial.print("Unexpected byte3 data ");
-    Serial.println(data, HEX);
+  if (slot == nullptr) {
+    slot = packets.reserve();
+    if (slot == nullptr) {
+      slot = &overflow;
+    }
+  }
+  slot->bytes[index++] = data;
+
+  // The bytes received so far form a sliding window. If they can't be the
+  // start of a packet, slide it until they can. This way we are in sync again
+  // as soon as six bytes with the right fixed bits have been received, instead
+  // of waiting for a packet boundary we may not know about.
+  while (index > 0) {
+    if (!plausible_byte0(slot->bytes[0])) {
+      errors::record(errors::unexpected_byte0, slot->bytes[0]);
+    } else if (index > 3 && !plausible_byte3(slot->bytes[3])) {
+      errors::record(errors::unexpected_byte3, slot->bytes[3]);
+    } else {
+      break;
+    }
+    index--;
+    memmove(slot->bytes, slot->bytes + 1, index);
+  }
 
+  if (index == synaptics::packet_size) {
+    if (slot == &overflow) {
+      errors::record(errors::packet_overflow);
+    } else {
+      slot->time = time;
+      packets.commit();
+    }
+    slot = nullptr;
     index = 0;
-    buffer = 0;
-    return;
   }
+}
 
-  buffer |= ((uint64_t)data) << index;
-  index += 8;
-  if (index == 48) {
-    packets.push_back(buffer);
-    index = 0;
-    buffer = 0;
+void send_report(uint8_t buttons, int8_t x, int8_t y, int8_t scroll) {
+  hid::report(buttons, x, y, scroll);
+  capture::report_sent(buttons, x, y, scroll);
+}
+
+// Which path through process_pending_packet() the packet has taken. Called
+// right after it, so the state reflects this packet.
+profile::path processed_path(const synaptics::packet& raw) {
+  uint8_t w = synaptics::decode_w(raw);
+  if (w == 3) {
+    return profile::guest;
+  } else if (w == 2) {
+    return profile::extended;
+  } else if (finger_count == 0) {
+    return profile::idle;
+  } else if (finger_count >= 2 && button_state == 0) {
+    return profile::scrolling;
   }
+  return profile::tracking;
 }
 
-void process_pending_packet(uint64_t packet) {
+void process_pending_packet(const synaptics::packet& raw) {
+  uint8_t w = synaptics::decode_w(raw);
+  if (w == 3) {
+    // Pass through. Guest packets are not touchpad frames. They don't advance
+    // the tick and don't go through the report queue.
+    parse_guest_packet(raw);
+    return;
+  }
+
   global_tick++;
-  uint8_t w =
-      (packet >> 26) & 0x01 | (packet >> 1) & 0x2 | (packet >> 2) & 0x0C;
 
   // When parsing packets, we queue the reports instead of send them directly.
   // Then we delay sending them for a few frames, to give us an opportunity to
@@ -163,33 +330,103 @@ void process_pending_packet(uint64_t packet) {
   if (global_tick - session_started_tick >= frames_delay) {
     if (!reports.empty()) {
       report item = reports.pop_front();
-      hid::report(item.buttons, item.x, item.y, item.scroll);
+      touchpad_buttons = item.buttons;
+      send_report(item.buttons | guest_buttons, item.x, item.y, item.scroll);
     }
   }
 
   switch (w) {
-    case 3:  // pass through
-      return;
     case 2:  // extended w mode
-      parse_extended_packet(packet);
+      parse_extended_packet(raw);
       return;
     default:
-      parse_primary_packet(packet, w);
+      parse_primary_packet(synaptics::decode_primary(raw));
       return;
   }
 }
 
-float to_hid_value(float value, float threshold, float scale_factor) {
-  const float hid_max = 127.0F;
-  if (abs(value) < threshold) {
+// Converts a delta in raw units to HID units, Q8. `threshold` is in raw units,
+// Q8, and `scale_factor` in HID units per raw unit, Q16. Deltas of more than
+// 2047 units and factors of 32 or more are clamped so that the product fits in
+// 32 bits. Either way the result would be hid_max.
+int16_t to_hid_value(int value, int32_t threshold, int32_t scale_factor) {
+  const int32_t hid_max = q8(127);
+  uint32_t magnitude = min(abs(value), 0x07FF);
+  if ((int32_t)(magnitude << 8) < threshold) {
     return 0;
   }
-  return sign(value) * min(max(abs(value) * scale_factor, 1.0F), hid_max);
+  int32_t hid = magnitude * min(scale_factor, q16(32) - 1) >> 8;
+  hid = constrain(hid, q8(1), hid_max);
+  return value < 0 ? -hid : hid;
+}
+
+// Length of (x, y) without a square root, from -3% to +1%. Alpha max plus beta
+// min, the larger of (1, 0) and (7/8, 1/2).
+uint16_t magnitude(uint16_t x, uint16_t y) {
+  uint16_t high = max(x, y);
+  uint16_t low = min(x, y);
+  return max(high, high - high / 8 + low / 2);
+}
+
+// Scroll for a vertical movement of the fingers in raw units, in detents, Q8.
+int16_t scroll_hid_value(int delta_y) {
+  int16_t scroll = to_hid_value(delta_y, device.noise_threshold_scrolling_y,
+                                device.scale_scroll);
+  if (abs(delta_y) <= device.slow_scroll_threshold) {
+    scroll = sign(scroll) * q8(slow_scroll_amount);
+  }
+  return scroll;
+}
+
+// Cursor movement for a movement of the tracking finger in raw units, with
+// `fingers` on the touchpad. The thresholds rise with the width and the
+// pressure of the finger, and the scale with its speed.
+void tracking_hid_values(int delta_x, int delta_y, short z, short width,
+                         int fingers, int8_t* hid_x, int8_t* hid_y) {
+  // If there are multiple fingers pressed, normal packets and secondary
+  // packets are alternated. So we should double the threshold.
+  // Q8.
+  uint32_t threshold_multiplier = fingers == 1 ? q8(1) : q8(2);
+  // Serial.print("Width: ");
+  // Serial.print(width);
+  // Serial.print(" Pressure: ");
+  // Serial.println(z);
+
+  if (width > 4) {
+    // Fat finger: 1 + (width - 4) / 4
+    threshold_multiplier = threshold_multiplier * width / 4;
+  }
+  if (z >= 60) {
+    // Heavy finger: 1 + (z - 60) / 40
+    threshold_multiplier = threshold_multiplier * (z - 20) / 40;
+  }
+
+  // In mm, Q8. Clamped to 64mm so that the velocity fits in 16 bits. Faster
+  // than that, the report saturates anyway.
+  int32_t delta_x_mm = (int32_t)delta_x * device.mm_per_unit_x >> 8;
+  int32_t delta_y_mm = (int32_t)delta_y * device.mm_per_unit_y >> 8;
+  delta_x_mm = min(abs(delta_x_mm), q8(64));
+  delta_y_mm = min(abs(delta_y_mm), q8(64));
+  // Precision for low speed and range for high speed. If there are more than
+  // one finger the speed needs to be doubled.
+  uint16_t velocity = magnitude(delta_x_mm, delta_y_mm);
+  if (fingers > 1) {
+    velocity *= 2;
+  }
+  int32_t scale_multiplier = acceleration_curve::at(velocity);
+
+  *hid_x = q8_to_int(to_hid_value(
+      delta_x, device.noise_threshold_tracking_x * threshold_multiplier >> 8,
+      device.scale_tracking_x * scale_multiplier >> 8));
+  *hid_y = -q8_to_int(to_hid_value(
+      delta_y, device.noise_threshold_tracking_y * threshold_multiplier >> 8,
+      device.scale_tracking_y * scale_multiplier >> 8));
 }
 
-void queue_report(uint8_t buttons, int8_t x, int8_t y, float scroll) {
-  static float scroll_amount_rollover = 0;
-  report item = {.buttons = buttons};
+// `scroll` is in detents, Q8.
+void queue_report(uint8_t buttons, int8_t x, int8_t y, int16_t scroll) {
+  static int16_t scroll_amount_rollover = 0;
+  report item = {buttons, 0, 0, 0};
   if (button_released_tick != 0 &&
       global_tick - button_released_tick < frames_stablization) {
     // When a button is released, we freeze the next few frames.
@@ -197,39 +434,37 @@ void queue_report(uint8_t buttons, int8_t x, int8_t y, float scroll) {
     item.y = 0;
     item.scroll = 0;
   } else {
-    if (scroll > -1.0F && scroll < 1.0F) {
+    if (scroll > -q8(1) && scroll < q8(1)) {
       scroll_amount_rollover += scroll;
-      if (scroll_amount_rollover >= 1.0F) {
-        scroll = 1.0F;
-        scroll_amount_rollover -= 1.0F;
-      } else if (scroll_amount_rollover <= -1.0F) {
-        scroll = -1.0F;
-        scroll_amount_rollover += 1.0F;
+      if (scroll_amount_rollover >= q8(1)) {
+        scroll = q8(1);
+        scroll_amount_rollover -= q8(1);
+      } else if (scroll_amount_rollover <= -q8(1)) {
+        scroll = -q8(1);
+        scroll_amount_rollover += q8(1);
       } else {
         scroll = 0;
       }
     }
     item.x = x;
     item.y = y;
-    item.scroll = scroll;
+    item.scroll = q8_to_int(scroll);
   }
   reports.push_back(item);
 }
 
-void parse_primary_packet(uint64_t packet, int w) {
-  // Reference: Section 3.2.1, Figure 3-4
-  int x = (packet >> 32) & 0x00FF | (packet >> 0) & 0x0F00 |
-          (packet >> 16) & 0x1000;
-  int y = (packet >> 40) & 0x00FF | (packet >> 4) & 0x0F00 |
-          (packet >> 17) & 0x1000;
-  short z = (packet >> 16) & 0xFF;
+void parse_primary_packet(const synaptics::contact& contact) {
+  int x = contact.x;
+  int y = contact.y;
+  short z = contact.z;
+  int w = contact.w;
   // w is width only if it >= 4. otherwise it encodes finger count
   short width = max(w, 4);
 
   // A clickpad reprots its button as a middle/up button. This logic needs to
   // change completely if the touchpad is not a clickpad (i.e. it has physical
   // buttons).
-  bool button = (packet >> 24) & 0x01;
+  bool button = contact.button;
   int new_finger_count = 0;
   if (z == 0) {
     new_finger_count = 0;
@@ -290,16 +525,14 @@ void parse_primary_packet(uint64_t packet, int w) {
   if (new_finger_count > 0) {
     finger_states[0].z = z;
 
-    int prev_x = finger_states[0].x.average();
-    int new_x = finger_states[0].x.filter(x);
-    if (prev_x > 0 && new_finger_count == finger_count) {
-      delta_x = new_x - prev_x;
+    averages<int> average_x = finger_states[0].x.update(x);
+    if (average_x.previous > 0 && new_finger_count == finger_count) {
+      delta_x = average_x.current - average_x.previous;
     }
 
-    int prev_y = finger_states[0].y.average();
-    int new_y = finger_states[0].y.filter(y);
-    if (prev_y > 0 && new_finger_count == finger_count) {
-      delta_y = new_y - prev_y;
+    averages<int> average_y = finger_states[0].y.update(y);
+    if (average_y.previous > 0 && new_finger_count == finger_count) {
+      delta_y = average_y.current - average_y.previous;
     }
   }
 
@@ -313,10 +546,14 @@ void parse_primary_packet(uint64_t packet, int w) {
       // emperical number and not always reliable. We err on the conservative
       // side. If we can't be sure, just reset the state. This could result in a
       // slightly jerky cursor movement.
-      if (abs(x - finger_states[0].x.average()) >= proximity_threshold_x ||
-          abs(y - finger_states[0].y.average()) >= proximity_threshold_y) {
-        if (abs(x - finger_states[1].x.average()) < proximity_threshold_x &&
-            abs(y - finger_states[1].y.average()) < proximity_threshold_y) {
+      if (abs(x - finger_states[0].x.average()) >=
+              device.proximity_threshold_x ||
+          abs(y - finger_states[0].y.average()) >=
+              device.proximity_threshold_y) {
+        if (abs(x - finger_states[1].x.average()) <
+                device.proximity_threshold_x &&
+            abs(y - finger_states[1].y.average()) <
+                device.proximity_threshold_y) {
           finger_states[0] = finger_states[1];
         } else {
           finger_states[0].x.reset();
@@ -334,7 +571,8 @@ void parse_primary_packet(uint64_t packet, int w) {
   }
 
   if (finger_count == 1 && new_finger_count == 1 &&
-      (abs(delta_x) >= max_delta_x || abs(delta_y) >= max_delta_y)) {
+      (abs(delta_x) >= device.max_delta_x ||
+       abs(delta_y) >= device.max_delta_y)) {
     // In rare occasions where a finger is released and another is pressed in
     // the same frame, we don't see a finger count change but a big jump in
     // finger position. In this case, reset the position and start over.
@@ -372,12 +610,7 @@ void parse_primary_packet(uint64_t packet, int w) {
 
     // Since we're scrolling, we are here every other frame. So we should double
     // the noise threshold.
-    float scroll_amount =
-        to_hid_value(delta_y, noise_threshold_scrolling_y, scale_scroll);
-    if (abs(delta_y) <= slow_scroll_threshold) {
-      scroll_amount = sign(scroll_amount) * slow_scroll_amount;
-    }
-    queue_report(button_state, 0, 0, scroll_amount);
+    queue_report(button_state, 0, 0, scroll_hid_value(delta_y));
   } else if (finger_count == 1 || finger_count >= 2 && button_state != 0) {
     // 1-finger tracking or 2-finger tracking
     if (button) {
@@ -389,50 +622,19 @@ void parse_primary_packet(uint64_t packet, int w) {
     } else {
       button_state = 0;
     }
-    // If there are multiple fingers pressed, normal packets and secondary
-    // packets are alternated. So we should double the threshold.
-    float threshold_multiplier = finger_count == 1 ? 1.0 : 2.0;
-    // Serial.print("Width: ");
-    // Serial.print(width);
-    // Serial.print(" Pressure: ");
-    // Serial.println(z);
-
-    if (width > 4) {
-      // Fat finger
-      threshold_multiplier *= 1.0F + (width - 4.0F) / 4.0F;
-    }
-    if (z >= 60) {
-      // Heavy finger
-      threshold_multiplier *= 1.0F + (z - 60.0F) / 40.0F;
-    }
-
-    float delta_x_mm = ((float)delta_x) / ((float)synaptics::units_per_mm_x);
-    float delta_y_mm = ((float)delta_y) / ((float)synaptics::units_per_mm_y);
-    // Precision for low speed and range for high speed. If there are more than
-    // one finger the speed needs to be doubled.
-    float velocity = sqrt(delta_x_mm * delta_x_mm + delta_y_mm * delta_y_mm);
-    if (finger_count > 1) {
-      velocity *= 2;
-    }
-    float scale_multiplier = 1.0F + velocity * 0.5F;  // Emperical constant
-
-    int8_t delta_x_hid =
-        to_hid_value(delta_x, noise_threshold_tracking_x * threshold_multiplier,
-                     scale_tracking_x * scale_multiplier);
-    int8_t delta_y_hid = -to_hid_value(
-        delta_y, noise_threshold_tracking_y * threshold_multiplier,
-        scale_tracking_y * scale_multiplier);
+    int8_t delta_x_hid, delta_y_hid;
+    tracking_hid_values(delta_x, delta_y, z, width, finger_count, &delta_x_hid,
+                        &delta_y_hid);
     queue_report(button_state, delta_x_hid, delta_y_hid, 0);
   }
 }
 
-void parse_extended_packet(uint64_t packet) {
-  uint8_t packet_code = (packet >> 44) & 0x0F;
-  if (packet_code == 1) {
-    // Reference: Section 3.2.9.2. Figure 3-14
-    int x = (packet >> 7) & 0x01FE | (packet >> 23) & 0x1E00;
-    int y = (packet >> 15) & 0x01FE | (packet >> 27) & 0x1E00;
-    short z = (packet >> 39) & 0x1D | (packet >> 23) & 0x60;
+void parse_extended_packet(const synaptics::packet& packet) {
+  if (synaptics::extended_packet_code(packet) == 1) {
+    synaptics::contact contact = synaptics::decode_secondary(packet);
+    int x = contact.x;
+    int y = contact.y;
+    short z = contact.z;
 
     if (x == 0 || y == 0 || z == 0) {
       finger_states[1].x.reset();
@@ -440,30 +642,33 @@ void parse_extended_packet(uint64_t packet) {
       return;
     }
 
-    int prev_x = finger_states[1].x.average();
-    int new_x = finger_states[1].x.filter(x);
-    int delta_x = prev_x == 0 ? 0 : new_x - prev_x;
+    averages<int> average_x = finger_states[1].x.update(x);
+    int delta_x = average_x.previous == 0
+                      ? 0
+                      : average_x.current - average_x.previous;
 
-    int prev_y = finger_states[1].y.average();
-    int new_y = finger_states[1].y.filter(y);
-    int delta_y = prev_y == 0 ? 0 : new_y - prev_y;
+    averages<int> average_y = finger_states[1].y.update(y);
+    int delta_y = average_y.previous == 0
+                      ? 0
+                      : average_y.current - average_y.previous;
 
-    if (abs(delta_x) >= max_delta_x || abs(delta_y) >= max_delta_y) {
+    if (abs(delta_x) >= device.max_delta_x ||
+        abs(delta_y) >= device.max_delta_y) {
       // Sometimes when a 2nd or 3rd finger is released, we receive a secondary
       // finger position before the finger count change. In this case, the new
       // secondary finger is not necessarily the same physical finger as
       // previous one. Not sure if this is by design or due to a packet loss.
       // In either case, we should not report this position change to avoid
       // jerky movements. Instead, reset the secondary finger state and start
-      // over.
+      // over from this position.
       finger_states[1].x.reset();
       finger_states[1].y.reset();
+      finger_states[1].x.filter(x);
+      finger_states[1].y.filter(y);
       delta_x = 0;
       delta_y = 0;
     }
 
-    finger_states[1].x.filter(x);
-    finger_states[1].y.filter(y);
     finger_states[1].z = z;
 
     // TODO: use velocity and z value to adjst the multiplier here too, just
@@ -471,22 +676,34 @@ void parse_extended_packet(uint64_t packet) {
     if (finger_count >= 2 && button_state == 0) {
       // Since we are parsing secondary packets, we are here every other frame,
       // so we should double the noise threshold.
-      float scroll_amount =
-          to_hid_value(delta_y, noise_threshold_scrolling_y, scale_scroll);
-      if (abs(delta_y) <= slow_scroll_threshold) {
-        scroll_amount = sign(scroll_amount) * slow_scroll_amount;
-      }
-      queue_report(button_state, 0, 0, scroll_amount);
+      queue_report(button_state, 0, 0, scroll_hid_value(delta_y));
     } else {
-      int8_t delta_x_hid = to_hid_value(
-          delta_x, noise_threshold_tracking_x * 2.0F, scale_tracking_x);
-      int8_t delta_y_hid = -to_hid_value(
-          delta_y, noise_threshold_tracking_y * 2.0F, scale_tracking_y);
+      int8_t delta_x_hid = q8_to_int(
+          to_hid_value(delta_x, device.noise_threshold_tracking_x * 2,
+                       device.scale_tracking_x));
+      int8_t delta_y_hid = -q8_to_int(
+          to_hid_value(delta_y, device.noise_threshold_tracking_y * 2,
+                       device.scale_tracking_y));
       queue_report(button_state, delta_x_hid, delta_y_hid, 0);
     }
   }
 }
 
+void parse_guest_packet(const synaptics::packet& packet) {
+  // The guest's standard PS/2 mouse packet is encapsulated in bytes 1, 4 and
+  // 5. Byte 1: Y overflow, X overflow, Y sign, X sign, 1, M, R, L.
+  uint8_t status = packet.bytes[1];
+  int delta_x = packet.bytes[4] - ((status << 4) & 0x100);
+  int delta_y = packet.bytes[5] - ((status << 3) & 0x100);
+  guest_buttons = status & 0x07;
+
+  // Sent right away. The touchpad smoothing doesn't apply to the guest.
+  const int hid_max = 127;
+  int8_t x = constrain(delta_x * q8(scale_guest) / 256, -hid_max, hid_max);
+  int8_t y = constrain(-delta_y * q8(scale_guest) / 256, -hid_max, hid_max);
+  send_report(touchpad_buttons | guest_buttons, x, y, 0);
+}
+
 void setup() {
   Serial.begin(115200);
   hid::init();
@@ -494,29 +711,46 @@ void setup() {
   // the touchpad. 500ms seems to be a good time. It's still not bullet proof
   // but the error handling mechanism seems to be able to recover every time.
   delay(500);
+  if (profiling) {
+    profile::begin();
+  }
   ps2::begin(0, 1, byte_received);
-  ps2::reset();
-  synaptics::init();
-
-  scale_tracking_x = scale_tracking_mm / synaptics::units_per_mm_x;
-  scale_tracking_y = scale_tracking_mm / synaptics::units_per_mm_y;
-  scale_scroll = scale_scroll_mm / synaptics::units_per_mm_y;
-  noise_threshold_tracking_x =
-      noise_threshold_tracking_mm * synaptics::units_per_mm_x;
-  noise_threshold_tracking_y =
-      noise_threshold_tracking_mm * synaptics::units_per_mm_y;
-  noise_threshold_scrolling_y =
-      noise_threshold_scrolling_mm * synaptics::units_per_mm_y;
-  max_delta_x = max_delta_mm * synaptics::units_per_mm_x;
-  max_delta_y = max_delta_mm * synaptics::units_per_mm_y;
-  slow_scroll_threshold = slow_scroll_threshold_mm * synaptics::units_per_mm_y;
-  proximity_threshold_x = proximity_threshold_mm * synaptics::units_per_mm_x;
-  proximity_threshold_y = proximity_threshold_mm * synaptics::units_per_mm_y;
+  // The touchpad may not answer while it's still starting up. Try again.
+  bool initialized = false;
+  for (int i = 0; i < init_attempts && !initialized; i++) {
+    // init() enables streaming even if the reset failed.
+    bool reset = ps2::reset();
+    initialized = synaptics::init() && reset;
+  }
+  if (!initialized && !capture::enabled()) {
+    Serial.println("Touchpad initialization failed.");
+  }
+
+  if (!load_known_device<0x0887>(&device)) {
+    // Never a division by zero: synaptics::init() only replaces the T1320A's
+    // resolution with non-zero answers.
+    device = make_device_params(synaptics::units_per_mm_x,
+                                synaptics::units_per_mm_y);
+  }
 }
 
 void loop() {
   if (!packets.empty()) {
-    uint64_t packet = packets.pop_front();
-    process_pending_packet(packet);
+    if (profiling) {
+      profile::start();
+    }
+    process_pending_packet(packets.front());
+    if (profiling) {
+      profile::stop(processed_path(packets.front()));
+    }
+    capture::packet_processed(packets.front());
+    packets.pop_front();
+  } else if (!capture::enabled()) {
+    // Only spend time on logging when there's no packet to process.
+    if (!errors::print_pending() && profiling) {
+      profile::print_pending();
+    }
   }
+  capture::poll();
+  ps2::poll();
 }